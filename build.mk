@@ -9,12 +9,19 @@ TARGET_SRC_PATH = src
 # Add include to all objects built for this target
 INCLUDE_DIRS += inc
 
+# Uncomment for LiquidCrystal::getStats() counters and histograms, and
+# for LiquidCrystal::trace()
+# CFLAGS += -DLCD_STATS=1
+# CFLAGS += -DLCD_TRACE=1
+
 # C source files included in this build.
 CSRC +=
 
 # C++ source files included in this build.
 CPPSRC += $(TARGET_SRC_PATH)/application.cpp
 CPPSRC += $(TARGET_SRC_PATH)/liquid-crystal-spi.cpp
+CPPSRC += $(TARGET_SRC_PATH)/liquid-crystal-widgets.cpp
+CPPSRC += $(TARGET_SRC_PATH)/liquid-crystal-scheduler.cpp
 CPPSRC += $(TARGET_SRC_PATH)/main.cpp
 CPPSRC += $(TARGET_SRC_PATH)/newlib_stubs.cpp
 CPPSRC += $(TARGET_SRC_PATH)/spark_utilities.cpp
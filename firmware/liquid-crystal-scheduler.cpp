@@ -0,0 +1,178 @@
+/*
+ * REFRESH SCHEDULER
+ * 74HC595 LIBRARY FOR SPARK CORE
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include <string.h>
+
+#include "liquid-crystal-scheduler.h"
+
+/* ========= LcdScheduler ================ */
+
+LcdScheduler::LcdScheduler(LiquidCrystal &lcd, uint16_t budgetUs)
+  : _lcd(lcd), _budget(budgetUs), _cellUs(0), _count(0)
+{
+}
+
+int8_t LcdScheduler::region(uint8_t col, uint8_t row, uint8_t width, uint8_t priority, uint8_t maxHz)
+{
+  if (_count == LCD_MAX_REGIONS) {
+    return -1;
+  }
+  Region &r = _regions[_count];
+  r.col = col;
+  r.row = row;
+  r.width = width < LCD_MAX_COLS ? width : LCD_MAX_COLS;
+  r.priority = priority;
+  r.interval = maxHz ? 1000000UL / maxHz : 0;
+  r.sent = micros() - r.interval;  // due right away
+  memset(r.text, ' ', sizeof(r.text));
+  r.dirty = true;  // blank it on the first tick()
+  r.started = false;
+  r.next = 0;
+  return _count++;
+}
+
+void LcdScheduler::set(int8_t region, const char *text)
+{
+  if (region < 0 || region >= _count) {
+    return;
+  }
+  char cells[LCD_MAX_COLS];
+  uint8_t width = _regions[region].width;
+  uint8_t i = 0;
+  for (; i < width && text[i]; i++) {
+    cells[i] = text[i];
+  }
+  memset(cells + i, ' ', width - i);
+  update(_regions[region], cells);
+}
+
+void LcdScheduler::setNumber(int8_t region, int32_t value, uint8_t decimals)
+{
+  if (region < 0 || region >= _count) {
+    return;
+  }
+  char cells[LCD_MAX_COLS];
+  LiquidCrystal::formatNumber(cells, _regions[region].width, value, decimals);
+  update(_regions[region], cells);
+}
+
+void LcdScheduler::setHex(int8_t region, uint32_t value)
+{
+  if (region < 0 || region >= _count) {
+    return;
+  }
+  char cells[LCD_MAX_COLS];
+  LiquidCrystal::formatHex(cells, _regions[region].width, value);
+  update(_regions[region], cells);
+}
+
+// Only the latest text is kept: a value replaced before tick() got to
+// it is never sent. A region that is partly sent stays started, so the
+// new text follows on the next tick() instead of after the interval.
+void LcdScheduler::update(Region &r, const char *cells)
+{
+  if (memcmp(r.text, cells, r.width)) {
+    memcpy(r.text, cells, r.width);
+    r.dirty = true;
+    r.next = 0;  // cells already sent may have changed again
+  }
+}
+
+// Send due regions, highest priority first, a cell at a time until the
+// next cell could overrun the budget. At least one cell goes out per
+// tick, so a budget shorter than a cell is slow rather than stuck.
+// Cells already showing the right character don't count. The cell cost
+// is the slowest cell of recent ticks, halving the gap to each tick's
+// slowest so one stalled cell doesn't shrink every later tick.
+uint32_t LcdScheduler::tick()
+{
+  uint32_t start = micros();
+  uint32_t used = 0;
+  uint32_t slowest = 0;
+  bool sentAny = false;
+  int8_t i;
+  while ((i = due(start)) >= 0) {
+    Region &r = _regions[i];
+    while (r.next < r.width) {
+      if (sentAny && used + _cellUs > _budget) {
+        learn(slowest);
+        return used;
+      }
+      uint32_t before = micros();
+      if (_lcd.printText(r.col + r.next, r.row, 1, &r.text[r.next])) {
+        uint32_t took = micros() - before;
+        if (took > slowest) {
+          slowest = took;
+        }
+        if (took > _cellUs) {
+          _cellUs = took < 0xFFFF ? took : 0xFFFF;  // no more of those this tick
+        }
+        sentAny = true;
+      }
+      r.started = true;
+      r.next++;
+      used = micros() - start;
+    }
+    r.dirty = false;
+    r.started = false;
+    r.next = 0;
+    r.sent = start;
+  }
+  learn(slowest);
+  return used;
+}
+
+void LcdScheduler::learn(uint32_t slowest)
+{
+  if (slowest && slowest < _cellUs) {
+    _cellUs -= (_cellUs - slowest + 1) / 2;
+  }
+}
+
+// The region to send next, -1 when none is due. A region cut short by
+// the budget is already under way and isn't held back by its rate, even
+// if its text changed since.
+int8_t LcdScheduler::due(uint32_t now)
+{
+  int8_t best = -1;
+  for (uint8_t i = 0; i < _count; i++) {
+    Region &r = _regions[i];
+    if (!r.dirty || (!r.started && now - r.sent < r.interval)) {
+      continue;
+    }
+    if (best < 0 || r.priority > _regions[best].priority ||
+        (r.priority == _regions[best].priority && now - r.sent > now - _regions[best].sent)) {
+      best = i;  // ties go to the one waiting longest
+    }
+  }
+  return best;
+}
+
+bool LcdScheduler::pending()
+{
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_regions[i].dirty) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void LcdScheduler::redraw()
+{
+  for (uint8_t i = 0; i < _count; i++) {
+    _regions[i].dirty = true;
+    _regions[i].next = 0;
+  }
+}
+
+void LcdScheduler::setBudget(uint16_t budgetUs)
+{
+  _budget = budgetUs;
+}
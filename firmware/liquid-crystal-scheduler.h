@@ -0,0 +1,74 @@
+#ifndef LiquidCrystalScheduler_h
+#define LiquidCrystalScheduler_h
+
+/*
+ * REFRESH SCHEDULER
+ * 74HC595 LIBRARY FOR SPARK CORE
+ * =======================================================
+ * Regions of the screen that the application updates as often
+ * as it likes. Only the latest text of each is kept, and tick()
+ * sends it no faster than the region's rate, most important
+ * region first, within a bus time budget per call:
+ *
+ *   LcdScheduler screen(lcd, 2000);    // at most 2ms per tick()
+ *   int8_t temp = screen.region(6, 0, 6, 2, 5);  // prio 2, 5Hz
+ *   int8_t clock = screen.region(0, 1, 8, 1, 1);  // prio 1, 1Hz
+ *
+ *   screen.setNumber(temp, readTemp(), 2);  // whenever
+ *   screen.tick();                          // every loop()
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include "liquid-crystal-spi.h"
+
+/* ========= Scheduler =================== */
+
+#define LCD_MAX_REGIONS 8
+
+// Cells go out through printText(), so unchanged ones cost nothing and
+// a region cut short by the budget carries on where the bus stopped on
+// the next tick(). Time is measured around the calls into LiquidCrystal,
+// so the budget is bus time in blocking mode; in async mode it only
+// bounds the time spent queueing.
+class LcdScheduler {
+public:
+  LcdScheduler(LiquidCrystal &lcd, uint16_t budgetUs);
+
+  // higher priority goes first, maxHz 0 for no cap; -1 when full
+  int8_t region(uint8_t col, uint8_t row, uint8_t width, uint8_t priority, uint8_t maxHz = 0);
+  void set(int8_t region, const char *text);
+  void setNumber(int8_t region, int32_t value, uint8_t decimals = 0);
+  void setHex(int8_t region, uint32_t value);
+  uint32_t tick();  // returns the microseconds spent
+  bool pending();   // some region still has to be sent
+  void redraw();    // the glass was cleared, send every region again
+  void setBudget(uint16_t budgetUs);
+private:
+  struct Region {
+    uint8_t col;
+    uint8_t row;
+    uint8_t width;
+    uint8_t priority;
+    bool    dirty;               // text isn't all on the glass yet
+    bool    started;             // partly sent, the rate doesn't hold it back
+    uint8_t next;                // first cell not sent yet
+    uint32_t interval;           // us between updates, 0 for no cap
+    uint32_t sent;               // micros() at the tick() that last finished it
+    char    text[LCD_MAX_COLS];  // latest cells, no terminating 0
+  };
+
+  void update(Region &, const char *cells);
+  int8_t due(uint32_t now);
+  void learn(uint32_t slowest);
+
+  LiquidCrystal &_lcd;
+  uint16_t _budget;
+  uint16_t _cellUs;   // what a cell is expected to take, see tick()
+  uint8_t _count;
+  Region _regions[LCD_MAX_REGIONS];
+};
+
+#endif
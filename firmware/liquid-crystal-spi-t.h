@@ -0,0 +1,126 @@
+#ifndef LiquidCrystalSPIT_h
+#define LiquidCrystalSPIT_h
+
+/*
+ * COMPILE-TIME WIRED LIQUIDCRYSTAL SPI
+ * 74HC595 LIBRARY FOR SPARK CORE
+ * =======================================================
+ * LiquidCrystalT<Transport, PinMap> is a LiquidCrystal whose
+ * 595 transport and bit assignments are fixed at compile time.
+ * Everything above the bus (the commands, framebuffer, async
+ * mode, skipped commands, stats and trace) is LiquidCrystal's;
+ * only the frames go out through Transport::sendFrames():
+ *
+ *   LiquidCrystalT<HardwareSpi595<A2>, AdafruitBackpack595> lcd;
+ *   LiquidCrystalT<SoftwareSpi595<D2, D3, D4>, AdafruitBackpack595> lcd;
+ *
+ *   lcd.begin(16, 2);   // no initSPI(), begin() sets up the transport
+ *
+ * The transports resolve their pins from PIN_MAP once in begin(),
+ * like initSPI() does. It costs the same on the bus as initSPI()
+ * with the same pins; what it saves is the transport dispatch in
+ * spiSendFrames() and the wiring setup in the application.
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include "liquid-crystal-spi.h"
+
+/* ========= Pin maps ==================== */
+
+// 74HC595 outputs (0 = QA ... 7 = QH) for each LCD line, 255 = none
+template <uint8_t QRS, uint8_t QE, uint8_t QD4, uint8_t QD5, uint8_t QD6, uint8_t QD7,
+          uint8_t QBL = 255>
+struct PinMap595 {
+  enum {
+    rs = QRS,
+    enable = QE,
+    d4 = QD4,
+    d5 = QD5,
+    d6 = QD6,
+    d7 = QD7,
+    backlight = QBL
+  };
+};
+
+// Adafruit I2C/SPI LCD Backpack or discrete hookup, same as initSPI()
+typedef PinMap595<1, 2, 6, 5, 4, 3, 7> AdafruitBackpack595;
+
+/* ========= Transports ================== */
+
+// Hardware SPI (A3 SCK, A5 MOSI) with any pin as the latch
+template <uint8_t LATCH>
+struct HardwareSpi595 {
+  static GPIO_TypeDef *latchPort;  // resolved from PIN_MAP in begin()
+  static uint16_t latchMask;
+
+  static void begin() {
+    pinMode(LATCH, OUTPUT);
+    digitalWrite(LATCH, HIGH);
+    latchPort = PIN_MAP[LATCH].gpio_peripheral;
+    latchMask = PIN_MAP[LATCH].gpio_pin;
+    SPI.begin();
+    SPI.setClockDivider(SPI_CLOCK_DIV8); // 72MHz / 8 = 9MHz
+    SPI.setDataMode(SPI_MODE0);
+    SPI.setBitOrder(MSBFIRST);
+  }
+  static void sendFrames(const uint8_t *frames, uint8_t count) {
+    GPIO_TypeDef *port = latchPort;
+    uint16_t mask = latchMask;
+    for (uint8_t i = 0; i < count; i++) {
+      port->BRR = mask;   // Latch Low
+      SPI.transfer(frames[i]);
+      port->BSRR = mask;  // Latch High (Data Latched)
+    }
+  }
+};
+
+template <uint8_t LATCH> GPIO_TypeDef *HardwareSpi595<LATCH>::latchPort;
+template <uint8_t LATCH> uint16_t HardwareSpi595<LATCH>::latchMask;
+
+// Software SPI on any three pins, the same unrolled loop as initSPI()
+template <uint8_t LATCH, uint8_t SCLK, uint8_t SDAT>
+struct SoftwareSpi595 {
+  static LcdSpiPins pins;  // resolved from PIN_MAP in begin()
+
+  static void begin() {
+    pinMode(LATCH, OUTPUT);
+    digitalWrite(LATCH, HIGH);
+    pinMode(SCLK, OUTPUT);
+    pinMode(SDAT, OUTPUT);
+    digitalWrite(SCLK, LOW);
+    digitalWrite(SDAT, LOW);
+    pins.latchPort = PIN_MAP[LATCH].gpio_peripheral;
+    pins.latchMask = PIN_MAP[LATCH].gpio_pin;
+    pins.sclkPort = PIN_MAP[SCLK].gpio_peripheral;
+    pins.sclkMask = PIN_MAP[SCLK].gpio_pin;
+    pins.sdatPort = PIN_MAP[SDAT].gpio_peripheral;
+    pins.sdatMask = PIN_MAP[SDAT].gpio_pin;
+  }
+  static void sendFrames(const uint8_t *frames, uint8_t count) {
+    lcdSoftSpiSend(pins, frames, count, 1);
+  }
+};
+
+template <uint8_t LATCH, uint8_t SCLK, uint8_t SDAT>
+LcdSpiPins SoftwareSpi595<LATCH, SCLK, SDAT>::pins;
+
+/* ========= LiquidCrystalT ============== */
+
+template <class Transport, class PinMap>
+class LiquidCrystalT : public LiquidCrystal {
+public:
+  LiquidCrystalT() : LiquidCrystal(255, 255, 255) {
+    initFrames(&Transport::sendFrames, PinMap::rs, PinMap::enable,
+               PinMap::d4, PinMap::d5, PinMap::d6, PinMap::d7, PinMap::backlight);
+  }
+
+  void begin(uint8_t cols, uint8_t lines, uint8_t dotsize = LCD_5x8DOTS) {
+    Transport::begin();
+    LiquidCrystal::begin(cols, lines, dotsize);
+  }
+};
+
+#endif
@@ -30,14 +30,80 @@
 
 /* ========= INCLUDES ==================== */
 
+#include <string.h>
+
 #include "liquid-crystal-spi.h"
 
 /* ========= LiquidCrystalSPI.cpp ======== */
 
+// DDRAM address of column 0 on each row
+static const uint8_t row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
+
+// async queue entry flags, on top of the 8 bit value
+#define LCD_QUEUE_DATA  0x0100 // RS high
+#define LCD_QUEUE_LATCH 0x0200 // just re-latch the 595 (backlight change)
+#define LCD_QUEUE_NIBBLE 0x0400 // one init nibble, RS low
+#define LCD_QUEUE_WAIT  0x0800 // timed init step, value picks the LCDTiming field
+#define LCD_QUEUE_READY 0x1000 // end of begin()
+
+// MCP23008 on the Adafruit backpack in I2C mode
+#define MCP23008_ADDRESS 0x20 // + A0-A2 jumpers
+#define MCP23008_IODIR   0x00
+#define MCP23008_IOCON   0x05
+#define MCP23008_GPIO    0x09
+#define MCP23008_SEQOP   0x20 // IOCON: address pointer doesn't move
+
+// START, address, register and first image of the next MCP23008 write
+// come before E can rise: 28 I2C clocks, 70us at the Core's max 400kHz
+#define LCD_I2C_LEAD_IN 70
+
+#define LCD_WAIT_POWERUP 0
+#define LCD_WAIT_RESET   1
+#define LCD_WAIT_INIT    2
+
+// entries that must be waited out, the busy flag isn't valid for them
+#define LCD_QUEUE_TIMED (LCD_QUEUE_LATCH | LCD_QUEUE_NIBBLE | LCD_QUEUE_WAIT | LCD_QUEUE_READY)
+
+// powerUp, reset, init, clear, home, command, data (us)
+//
+// HD44780U: 40ms power up, 4.1ms after the first function set, 100us
+// after the next. Clear/home take 1.52ms, instructions 37us and a data
+// write 37us + tADD 4us at the typical 270kHz oscillator; these are
+// scaled by 270/190 for the 190kHz minimum (a 3.3V supply runs slow).
+const LCDTiming LCD_TIMING_HD44780      = { 50000, 4500,  150, 2200, 2200, 53, 59 };
+// WS0010: clear and home take 6.2ms, everything else is done in under
+// 10us. The init steps keep the 5ms waits the V1 OLEDs were tested with.
+const LCDTiming LCD_TIMING_WINSTAR_OLED = { 50000, 5000, 5000, 6200, 6200, 10, 10 };
+// HD44780 instruction timing, same 5ms init steps as the Winstar.
+const LCDTiming LCD_TIMING_ADH_OLED     = { 50000, 5000, 5000, 2200, 2200, 53, 59 };
+
+// we count rows starting w/0, row_offsets[] has LCD_MAX_ROWS of them
+static uint8_t lcdCursorRow(uint8_t row, uint8_t numlines)
+{
+  if (numlines > LCD_MAX_ROWS) {
+    numlines = LCD_MAX_ROWS;
+  }
+  if (row >= numlines) {
+    row = numlines ? numlines - 1 : 0;
+  }
+  return row;
+}
+
+static uint8_t lcdDdramAddress(uint8_t col, uint8_t row)
+{
+  return row_offsets[row] + col;
+}
+
 LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
            uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3,
            uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
 {
+  _usingSpi = false;
+  _softSpi = false;
+  _timing = LCD_TIMING_HD44780;
+  _bus = 0;
+  _i2c = false;
+  _sendFrames = 0;
   init(0, rs, rw, enable, d0, d1, d2, d3, d4, d5, d6, d7, 255);
 }
 
@@ -45,30 +111,53 @@ LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable,
            uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3,
            uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
 {
+  _usingSpi = false;
+  _softSpi = false;
+  _timing = LCD_TIMING_HD44780;
+  _bus = 0;
+  _i2c = false;
+  _sendFrames = 0;
   init(0, rs, 255, enable, d0, d1, d2, d3, d4, d5, d6, d7, 255);
 }
 
 LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
            uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
 {
+  _usingSpi = false;
+  _softSpi = false;
+  _timing = LCD_TIMING_HD44780;
+  _bus = 0;
+  _i2c = false;
+  _sendFrames = 0;
   init(1, rs, rw, enable, d0, d1, d2, d3, 0, 0, 0, 0, 255);
 }
 
 LiquidCrystal::LiquidCrystal(uint8_t rs,  uint8_t enable,
            uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
 {
+  _usingSpi = false;
+  _softSpi = false;
+  _timing = LCD_TIMING_HD44780;
+  _bus = 0;
+  _i2c = false;
+  _sendFrames = 0;
   init(1, rs, 255, enable, d0, d1, d2, d3, 0, 0, 0, 0, 255);
 }
 
 LiquidCrystal::LiquidCrystal(uint8_t ss, uint8_t sclk, uint8_t sdat) //SPI  ##############################
 {
   _latchPin = ss;
+  _usingSpi = false; // set by initSPI()
   _softSpi = false; // assume we are using hardware SPI
   if(sclk != 255 && sdat != 255) {
     _softSpi = true; // on second thought, let's use software SPI
   }
   _sclkPin = sclk;
   _sdatPin = sdat;
+  _timing = LCD_TIMING_HD44780;
+  _bus = 0;
+  _i2c = false;
+  _sendFrames = 0;
   
   /*
   initSPI(ssPin);
@@ -82,9 +171,15 @@ void LiquidCrystal::initSPI(void) //SPI ########################################
 {
   // initialize SPI:
   _usingSpi = true;
+  _i2c = false;
+  _bitString = 0;
+  _dataByte = 0;
+  _frameBytes = 1;
   
   pinMode (_latchPin, OUTPUT); // setup _latchPin used in hardware and software SPI
   digitalWrite(_latchPin, HIGH);
+  _spiPins.latchPort = PIN_MAP[_latchPin].gpio_peripheral;
+  _spiPins.latchMask = PIN_MAP[_latchPin].gpio_pin;
 
   // If we're using software SPI, setup the clock and data pins.
   if(_softSpi) {
@@ -92,6 +187,10 @@ void LiquidCrystal::initSPI(void) //SPI ########################################
     pinMode(_sdatPin, OUTPUT);
     digitalWrite(_sclkPin, LOW);
     digitalWrite(_sdatPin, LOW);
+    _spiPins.sclkPort = PIN_MAP[_sclkPin].gpio_peripheral;
+    _spiPins.sclkMask = PIN_MAP[_sclkPin].gpio_pin;
+    _spiPins.sdatPort = PIN_MAP[_sdatPin].gpio_peripheral;
+    _spiPins.sdatMask = PIN_MAP[_sdatPin].gpio_pin;
   }
   else { // Else set up the hardware SPI
     SPI.begin();
@@ -100,7 +199,7 @@ void LiquidCrystal::initSPI(void) //SPI ########################################
     _clockDivider = SPI_CLOCK_DIV8; // 72MHz / 8 = 9MHz (Really is about twice as fast as 4.5MHz)
     //_clockDivider = SPI_CLOCK_DIV16; // 72MHz / 16 = 4.5MHz
     SPI.setClockDivider(_clockDivider);
-    // FYI: Software SPI is about the same speed as SPI_CLOCK_DIV8 ! :)
+    // FYI: Software SPI is a little faster than SPI_CLOCK_DIV8 ! :)
     
     // Set data mode to SPI_MODE0 by default
     _dataMode = SPI_MODE0;
@@ -116,6 +215,76 @@ void LiquidCrystal::initSPI(void) //SPI ########################################
   init(1, 1, 255, 2, 0, 0, 0, 0, 6, 5, 4, 3, 7);
 }
 
+// A 595 wired like initSPI() (4-bit, no RW) whose frames go to send
+// instead of the built in transports. Touches no pins, so it can run in
+// a constructor; setting up whatever send drives is up to the caller.
+void LiquidCrystal::initFrames(LcdFrameSender send, uint8_t rs, uint8_t enable,
+                               uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7, uint8_t backlight)
+{
+  _usingSpi = true; // _bitString path
+  _i2c = false;
+  _softSpi = false;
+  _sendFrames = send;
+  _bitString = 0;
+  _dataByte = 0;
+  _frameBytes = 1;
+  init(1, rs, 255, enable, 0, 0, 0, 0, d4, d5, d6, d7, backlight);
+}
+
+// Two daisy-chained 595s, same pins as initSPI(). The first has RS, E
+// and the backlight where the backpack has them, the second (QH' of the
+// first into its SER) drives DB0-DB7 on QA-QH. Every E edge is one
+// 16-bit transfer, so the LCD runs in 8-bit mode at 2 latches a byte.
+void LiquidCrystal::initSPI16(void)
+{
+  initSPI();
+  _frameBytes = 2;
+  // 8-15 are the second 595's outputs
+  init(0, 1, 255, 2, 8, 9, 10, 11, 12, 13, 14, 15, 7);
+}
+
+// Adafruit I2C/SPI LCD Backpack with the I2C jumper: the same images as
+// SPI go to the MCP23008 GPIO register. SEQOP keeps the register pointer
+// on GPIO, so every byte of a write is the next image and a whole
+// character with its E strobes is one I2C transaction. The constructor's
+// ss is the A0-A2 jumper setting, 0 on an unmodified backpack.
+void LiquidCrystal::initI2C(void)
+{
+  _usingSpi = true; // _bitString path
+  _i2c = true;
+  _softSpi = false;
+  _bitString = 0;
+  _dataByte = 0;
+  _frameBytes = 1;
+
+  Wire.begin();
+  Wire.beginTransmission(MCP23008_ADDRESS | (_latchPin & 0x07));
+  Wire.write(MCP23008_IOCON);
+  Wire.write(MCP23008_SEQOP);
+  Wire.endTransmission();
+  Wire.beginTransmission(MCP23008_ADDRESS | (_latchPin & 0x07));
+  Wire.write(MCP23008_IODIR);
+  Wire.write(0x00);                // all outputs
+  Wire.endTransmission();
+
+  // GP1 RS, GP2 E, GP3-GP6 DB4-DB7, GP7 backlight
+  init(1, 1, 255, 2, 0, 0, 0, 0, 3, 4, 5, 6, 7);
+}
+
+// Hardware SPI clock, SPI_CLOCK_DIV8 unless changed here after initSPI()
+void LiquidCrystal::setClockDivider(uint8_t divider)
+{
+  _clockDivider = divider;
+  if (_bus) {
+    if (_bus->_owner == this) {
+      _bus->_owner = 0; // reload on the next transfer
+    }
+  }
+  else if (_usingSpi && !_softSpi) {
+    SPI.setClockDivider(_clockDivider);
+  }
+}
+
 void LiquidCrystal::init(uint8_t fourbitmode, uint8_t rs, uint8_t rw, uint8_t enable,
   uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3,
   uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7, uint8_t backlight)
@@ -135,19 +304,47 @@ void LiquidCrystal::init(uint8_t fourbitmode, uint8_t rs, uint8_t rw, uint8_t en
   _data_pins[6] = d6;
   _data_pins[7] = d7; 
   
-  pinMode(_rs_pin, OUTPUT);
-  // we can save 1 pin by not using RW. Indicate by passing 255 instead of pin#
-  if (_rw_pin != 255) { 
-    pinMode(_rw_pin, OUTPUT);
+  // with SPI/I2C these are 595/MCP23008 outputs, not Core pins (D1 is SCL!)
+  if (!_usingSpi) {
+    pinMode(_rs_pin, OUTPUT);
+    // we can save 1 pin by not using RW. Indicate by passing 255 instead of pin#
+    if (_rw_pin != 255) { 
+      pinMode(_rw_pin, OUTPUT);
+    }
+    pinMode(_enable_pin, OUTPUT);
   }
-  pinMode(_enable_pin, OUTPUT);
   
-  // Always 4-bit mode, don't waste pins!
+  // 8-bit mode when all eight data lines are wired: the 8 data pin
+  // constructors, or cascaded 595s
   //
-  //if (fourbitmode)
+  if (fourbitmode)
     _displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
-  //else 
-    //_displayfunction = LCD_8BITMODE | LCD_1LINE | LCD_5x8DOTS;
+  else 
+    _displayfunction = LCD_8BITMODE | LCD_1LINE | LCD_5x8DOTS;
+  
+  if (!_usingSpi) {
+    resolvePins(fourbitmode ? 4 : 8);
+  }
+  buildNibbleTable();
+
+  _framebuffer = false;
+  _async = false;
+  _polling = false;
+  _qHead = 0;
+  _qTail = 0;
+  _qTimed = false;
+  _initialized = false;
+  _glassValid = false;
+  _skipped = 0;
+  resetStats();
+  LCD_TRACED(_trace = 0);
+  LCD_TRACED(_traceLines = 0);
+  forget();
+  forgetGlyphs();
+  _glyphHits = 0;
+  _glyphMisses = 0;
+  _cols = 16;
+  _dataInput = false;
   
   //begin(16, 2); // commented out, make sure you call this in code!
   
@@ -164,76 +361,128 @@ void LiquidCrystal::init(uint8_t fourbitmode, uint8_t rs, uint8_t rw, uint8_t en
 }
 
 void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
+  // anything still queued is dropped, in async mode the init sequence
+  // below is queued instead and poll() works through it
+  _qHead = _qTail;
+  _qDeadline = micros();
+  _qTimed = true;
+  _initialized = false;
+  forget(); // the init nibbles leave the registers in any state
+  forgetGlyphs(); // and CGRAM isn't cleared at power up
+
   if (lines > 1) {
     _displayfunction |= LCD_2LINE;
   }
   _numlines = lines;
   _currline = 0;
+  _cols = cols;
 
   // for some 1 line displays you can select a 10 pixel high font
   if ((dotsize != 0) && (lines == 1)) {
     _displayfunction |= LCD_5x10DOTS;
   }
 
+  // Now we pull both RS and R/W low to begin commands
+  if (!_usingSpi) {
+    digitalWrite(_rs_pin, LOW);
+    digitalWrite(_enable_pin, LOW);
+    if (_rw_pin != 255) { 
+      digitalWrite(_rw_pin, LOW);
+    }
+  }
+
   // SEE PAGE 45/46 FOR INITIALIZATION SPECIFICATION!
   // according to datasheet, we need at least 40ms after power rises above 2.7V
   // before sending commands. Arduino can turn on way befer 4.5V so we'll wait 50
-  delayMicroseconds(50000); 
-  // Now we pull both RS and R/W low to begin commands
-  digitalWrite(_rs_pin, LOW);
-  digitalWrite(_enable_pin, LOW);
-  if (_rw_pin != 255) { 
-    digitalWrite(_rw_pin, LOW);
-  }
+  post(LCD_QUEUE_WAIT | LCD_WAIT_POWERUP);
   
-  // 4-Bit initialization sequence from Technobly
-  write4bits(0x03);         // Put back into 8-bit mode
-  delayMicroseconds(5000);
+  if (_displayfunction & LCD_8BITMODE) {
+    // 8-Bit initialization: function set three times, see page 45
+    post(LCD_QUEUE_NIBBLE | 0x03);
+    post(LCD_QUEUE_WAIT | LCD_WAIT_RESET);
+    post(LCD_QUEUE_NIBBLE | 0x03);
+    post(LCD_QUEUE_WAIT | LCD_WAIT_INIT);
+    post(LCD_QUEUE_NIBBLE | 0x03);
+    post(LCD_QUEUE_WAIT | LCD_WAIT_INIT);
+  }
+  else {
+    // 4-Bit initialization sequence from Technobly
+    post(LCD_QUEUE_NIBBLE | 0x03);          // Put back into 8-bit mode
+    post(LCD_QUEUE_WAIT | LCD_WAIT_RESET);
 
-  write4bits(0x08);         // Comment this out for V1 OLED
-  delayMicroseconds(5000);  // Comment this out for V1 OLED
+    post(LCD_QUEUE_NIBBLE | 0x08);          // Comment this out for V1 OLED
+    post(LCD_QUEUE_WAIT | LCD_WAIT_INIT);   // Comment this out for V1 OLED
   
-  write4bits(0x02);         // Put into 4-bit mode
-  delayMicroseconds(5000);
-  write4bits(0x02);
-  delayMicroseconds(5000);
-  write4bits(0x08);
-  delayMicroseconds(5000);
+    post(LCD_QUEUE_NIBBLE | 0x02);          // Put into 4-bit mode
+    post(LCD_QUEUE_WAIT | LCD_WAIT_INIT);
+    post(LCD_QUEUE_NIBBLE | 0x02);
+    post(LCD_QUEUE_WAIT | LCD_WAIT_INIT);
+    post(LCD_QUEUE_NIBBLE | 0x08);
+    post(LCD_QUEUE_WAIT | LCD_WAIT_INIT);
+  }
   
   command(LCD_DISPLAYCONTROL);                  // Turn Off
-  delayMicroseconds(5000);
+  post(LCD_QUEUE_WAIT | LCD_WAIT_INIT);
   command(LCD_FUNCTIONSET | _displayfunction);  // Set # lines, font size, etc.
-  delayMicroseconds(5000);
-  clear();                                      // Clear Display
-  command(LCD_ENTRYMODESET | LCD_ENTRYLEFT);    // Set Entry Mode
-  delayMicroseconds(5000);
-  home();                                       // Home Cursor
-  delayMicroseconds(5000);
-  command(LCD_DISPLAYCONTROL | LCD_DISPLAYON);  // Turn On - enable cursor & blink
-  delayMicroseconds(5000);
+  post(LCD_QUEUE_WAIT | LCD_WAIT_INIT);
+  command(LCD_CLEARDISPLAY);                    // Clear Display
+  _displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
+  command(LCD_ENTRYMODESET | _displaymode);     // Set Entry Mode
+  post(LCD_QUEUE_WAIT | LCD_WAIT_INIT);
+  command(LCD_RETURNHOME);                      // Home Cursor
+  _displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
+  command(LCD_DISPLAYCONTROL | _displaycontrol); // Turn On - cursor & blink off
+  post(LCD_QUEUE_WAIT | LCD_WAIT_INIT);
+  post(LCD_QUEUE_READY);
+
+  // the glass is blank and the cursor is home
+  memset(_frame, ' ', sizeof(_frame));
+  memset(_glass, ' ', sizeof(_glass));
+  _glassValid = true;
+  _fbCol = 0;
+  _fbRow = 0;
+}
+
+// Settle times for the attached controller, LCD_TIMING_HD44780 by default.
+// Call before begin() so the init sequence uses them too.
+void LiquidCrystal::setTiming(const LCDTiming &timing)
+{
+  _timing = timing;
 }
 
 /********** high level commands, for the user! */
 void LiquidCrystal::clear()
 {
+  if (_framebuffer) {
+    // flush() rewrites only the cells that weren't blank already
+    memset(_frame, ' ', sizeof(_frame));
+    _fbCol = 0;
+    _fbRow = 0;
+    return;
+  }
   command(LCD_CLEARDISPLAY);  // clear display, set cursor position to zero
-  delayMicroseconds(5000);  // this command takes a long time!
 }
 
 void LiquidCrystal::home()
 {
+  if (_framebuffer) {
+    _fbCol = 0;
+    _fbRow = 0;
+    return;
+  }
   command(LCD_RETURNHOME);  // set cursor position to zero
-  delayMicroseconds(5000);  // this command takes a long time!
 }
 
 void LiquidCrystal::setCursor(uint8_t col, uint8_t row)
 {
-  int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-  if ( row > _numlines ) {
-    row = _numlines-1;    // we count rows starting w/0
+  row = lcdCursorRow(row, _numlines);
+
+  if (_framebuffer) {
+    _fbCol = col;
+    _fbRow = row;
+    return;
   }
-  
-  command(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+  command(LCD_SETDDRAMADDR | lcdDdramAddress(col, row));
 }
 
 // Turn the display on/off (quickly)
@@ -300,12 +549,116 @@ void LiquidCrystal::noAutoscroll(void) {
 
 // Allows us to fill the first 8 CGRAM locations
 // with custom characters
+// Arduino's signature, the bitmap isn't written to
 void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
+  createChar(location, (const uint8_t *)charmap);
+}
+
+void LiquidCrystal::createChar(uint8_t location, const uint8_t charmap[]) {
   location &= 0x7; // we only have 8 locations 0-7
+  _glyphHash[location] = 0; // no longer whatever glyph() put there
   command(LCD_SETCGRAMADDR | (location << 3));
   for (int i=0; i<8; i++) {
-    write(charmap[i]);
+    send(charmap[i], HIGH); // straight to CGRAM, even in framebuffer mode
+  }
+}
+
+// Glyph cache: glyph() returns the character code (0-7) that shows
+// bitmap, uploading it to CGRAM only if it isn't already in a slot.
+// ids are the application's, any number of them. On a miss the least
+// recently used glyph that isn't on screen is replaced; if all 8 are
+// showing, the least recently used one goes anyway. The cursor is put
+// back where it was, so write() the code straight after. Where it was
+// isn't known after createChar() or command(), and it goes to 0,0.
+uint8_t LiquidCrystal::glyph(uint16_t id, const uint8_t bitmap[]) {
+  // FNV-1a over the id and the bitmap, folded to 16 bits
+  uint32_t h = 2166136261UL;
+  h = (h ^ (id & 0xFF)) * 16777619UL;
+  h = (h ^ (id >> 8)) * 16777619UL;
+  for (uint8_t i = 0; i < 8; i++) {
+    h = (h ^ bitmap[i]) * 16777619UL;
+  }
+  uint16_t hash = (h ^ (h >> 16)) & 0xFFFF;
+  if (hash == 0) {
+    hash = 1; // 0 marks a free slot
+  }
+
+  _glyphClock++;
+  for (uint8_t slot = 0; slot < 8; slot++) {
+    if (_glyphHash[slot] == hash && _glyphId[slot] == id) {
+      _glyphUsed[slot] = _glyphClock;
+      _glyphHits++;
+      return slot;
+    }
+  }
+  _glyphMisses++;
+
+  // a free slot, else the oldest one off screen, else the oldest one
+  uint8_t visible = visibleGlyphs();
+  uint8_t victim = 0;
+  uint16_t oldest = 0;
+  bool hidden = false;
+  for (uint8_t slot = 0; slot < 8; slot++) {
+    if (_glyphHash[slot] == 0) {
+      victim = slot;
+      break;
+    }
+    uint16_t age = _glyphClock - _glyphUsed[slot];
+    bool off = !(visible & (1 << slot));
+    if ((off && !hidden) || (off == hidden && age > oldest)) {
+      victim = slot;
+      oldest = age;
+      hidden = off;
+    }
+  }
+
+  uint8_t ddram = _ddramAddr;
+  createChar(victim, bitmap);
+  _glyphId[victim] = id;
+  _glyphHash[victim] = hash;
+  _glyphUsed[victim] = _glyphClock;
+  if (!_framebuffer) {
+    // back out of CGRAM, flush() readdresses anyway
+    command(LCD_SETDDRAMADDR | (ddram == 0xFF ? 0 : ddram));
   }
+  return victim;
+}
+
+size_t LiquidCrystal::writeGlyph(uint16_t id, const uint8_t bitmap[]) {
+  return write(glyph(id, bitmap));
+}
+
+uint32_t LiquidCrystal::glyphHits(void) {
+  return _glyphHits;
+}
+
+uint32_t LiquidCrystal::glyphMisses(void) {
+  return _glyphMisses;
+}
+
+// CGRAM slots that are or may soon be on the glass: everything written
+// to DDRAM since the last clear, or in framebuffer mode whatever the
+// framebuffer and the glass hold
+uint8_t LiquidCrystal::visibleGlyphs(void) {
+  if (!_framebuffer) {
+    return _glyphShown;
+  }
+  uint8_t visible = _glassValid ? 0 : _glyphShown;
+  for (uint8_t i = 0; i < sizeof(_frame); i++) {
+    if (_frame[i] < 16) {
+      visible |= 1 << (_frame[i] & 0x07);
+    }
+    if (_glassValid && _glass[i] < 16) {
+      visible |= 1 << (_glass[i] & 0x07);
+    }
+  }
+  return visible;
+}
+
+void LiquidCrystal::forgetGlyphs(void) {
+  memset(_glyphHash, 0, sizeof(_glyphHash));
+  _glyphClock = 0;
+  _glyphShown = 0;
 }
 
 // Turn the backlight on/off
@@ -313,41 +666,664 @@ void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
 void LiquidCrystal::backlight(void) {
   _backlight = 1;
   // add the backlight bit on all transfers
-  bitWrite(_bitString, _backlight_pin, 1);
   // and send it out
-  spiSendOut();
+  post(LCD_QUEUE_LATCH);
 }
 void LiquidCrystal::noBacklight(void) {
   _backlight = 0;
   // add the backlight bit on all transfers
-  bitWrite(_bitString, _backlight_pin, 0);
   // and send it out
-  spiSendOut();
+  post(LCD_QUEUE_LATCH);
+}
+
+// Framebuffer mode: write(), print(), setCursor(), clear() and home()
+// only update RAM, and flush() sends the cells that changed since the
+// last flush. Scrolling and autoscroll move the glass under the buffer,
+// so don't mix them with framebuffer mode.
+void LiquidCrystal::framebuffer(void) {
+  if (_framebuffer) {
+    return;
+  }
+  _framebuffer = true;
+  memset(_frame, ' ', sizeof(_frame));
+  _fbCol = 0;
+  _fbRow = 0;
+}
+void LiquidCrystal::noFramebuffer(void) {
+  _framebuffer = false;
+}
+
+// Send the changed cells, one LCD_SETDDRAMADDR per run of changes
+void LiquidCrystal::flush(void) {
+  uint8_t cols = _cols < LCD_MAX_COLS ? _cols : LCD_MAX_COLS;
+  uint8_t rows = _numlines < LCD_MAX_ROWS ? _numlines : LCD_MAX_ROWS;
+
+  // runs are written left to right
+  if (_displaymode != LCD_ENTRYLEFT) {
+    send(LCD_ENTRYMODESET | LCD_ENTRYLEFT, LOW);
+  }
+
+  for (uint8_t row = 0; row < rows; row++) {
+    uint8_t *f = frameCell(0, row);
+    uint8_t *g = &_glass[f - _frame];
+    uint8_t col = 0;
+
+    while (col < cols) {
+      if (_glassValid && f[col] == g[col]) {
+        col++;
+        continue;
+      }
+      // rewriting one unchanged cell costs no more than a new address,
+      // so runs separated by a single clean cell are merged
+      uint8_t end = col + 1;
+      while (end < cols) {
+        if (!_glassValid || f[end] != g[end]) {
+          end++;
+        }
+        else if (end + 1 < cols && f[end + 1] != g[end + 1]) {
+          end += 2;
+        }
+        else {
+          break;
+        }
+      }
+
+      // skipped by send() when the cursor is already there
+      send(LCD_SETDDRAMADDR | lcdDdramAddress(col, row), LOW);
+      for (; col < end; col++) {
+        send(f[col], HIGH);
+        g[col] = f[col];
+      }
+    }
+  }
+  _glassValid = true;
+
+  if (_displaymode != LCD_ENTRYLEFT) {
+    send(LCD_ENTRYMODESET | _displaymode, LOW);
+  }
+}
+
+// Async mode: command(), write() and everything built on them go into a
+// ring buffer instead of waiting for the LCD. poll() sends whatever is
+// due, honoring each command's execution time as a deadline, so call it
+// from loop() or from a timer interrupt (not both).
+void LiquidCrystal::async(void) {
+  _qDeadline = micros();
+  _async = true;
+}
+void LiquidCrystal::noAsync(void) {
+  flushBlocking();
+  _async = false;
+}
+
+void LiquidCrystal::poll(void) {
+  if (_polling) {
+    return; // interrupted ourselves
+  }
+  _polling = true;
+  while (_qHead != _qTail && canSend()) {
+    uint16_t entry = _queue[_qHead];
+    transmit(entry);
+    _qDeadline = micros() + settleTime(entry);
+    _qTimed = entry & LCD_QUEUE_TIMED;
+    _qHead = (_qHead + 1) & (LCD_QUEUE_SIZE - 1);
+  }
+  _polling = false;
+}
+
+// Wait until everything queued has been sent and executed
+void LiquidCrystal::flushBlocking(void) {
+  while (_qHead != _qTail) {
+    poll();
+  }
+  while (!canSend()) {
+    ;
+  }
+}
+
+uint8_t LiquidCrystal::queueDepth(void) {
+  return (_qTail - _qHead) & (LCD_QUEUE_SIZE - 1);
+}
+
+// The LCD takes the next entry once the last one's settle time is up,
+// or earlier if RW is wired and the busy flag is already clear.
+bool LiquidCrystal::canSend(void) {
+  if ((int32_t)(micros() - _qDeadline) >= 0) {
+    return true;
+  }
+  return _rw_pin != 255 && !_qTimed && !(readByte(LOW) & 0x80);
+}
+
+// begin() has finished. Always true after it returns, except in async
+// mode where poll() has to work through the init sequence first; text
+// written in the meantime is queued behind it.
+bool LiquidCrystal::ready(void) {
+  return _initialized;
 }
 
 /*********** mid level commands, for sending data/cmds */
 
-inline void LiquidCrystal::command(uint8_t value) {
+void LiquidCrystal::command(uint8_t value) {
   send(value, LOW);
 }
 
+// how many commands so far changed nothing and were never sent
+uint32_t LiquidCrystal::skippedCommands(void) {
+  return _skipped;
+}
+
+// Counters and latency histograms since the last resetStats(), all
+// zero unless built with LCD_STATS
+const LCDStats &LiquidCrystal::getStats(void) {
+#if LCD_STATS
+  return _stats;
+#else
+  static const LCDStats none = LCDStats();
+  return none;
+#endif
+}
+
+void LiquidCrystal::resetStats(void) {
+#if LCD_STATS
+  memset(&_stats, 0, sizeof(_stats));
+  LCD_CYCLE_COUNTER_START();
+#endif
+}
+
+// Record every frame that goes out to the LCD into t, 0 to stop.
+// Needs a build with LCD_TRACE, otherwise this does nothing.
+void LiquidCrystal::trace(LiquidCrystalTrace *t) {
+#if LCD_TRACE
+  _trace = t;
+#else
+  (void)t;
+#endif
+}
+
+#if LCD_STATS
+// count one latency since start in its power of two bin
+void LiquidCrystal::record(uint32_t *histogram, uint32_t start) {
+  uint32_t cycles = (LCD_CYCLE_COUNTER() - start) >> 8;
+  uint8_t bin = 0;
+  while (cycles && bin < LCD_STATS_BINS - 1) {
+    cycles >>= 1;
+    bin++;
+  }
+  histogram[bin]++;
+}
+#endif
+
+// Address counter, DDRAM or CGRAM depending on which was set last.
+// Needs RW wired (parallel only), returns 0 otherwise.
+uint8_t LiquidCrystal::readAddress(void) {
+  if (_rw_pin == 255) {
+    return 0;
+  }
+  if (_async) {
+    flushBlocking();
+  }
+  return waitReady(_timing.clear);
+}
+
+// DDRAM or CGRAM contents at the address counter, which then moves on
+// like it does for write(). Needs RW wired, returns 0 otherwise.
+uint8_t LiquidCrystal::read(void) {
+  if (_rw_pin == 255) {
+    return 0;
+  }
+  if (_async) {
+    flushBlocking();
+  }
+  waitReady(_timing.clear);
+  moveAddress(_lcdEntry & LCD_ENTRYLEFT);  // like a write, minus the shift
+  uint8_t value = readByte(HIGH);
+  waitReady(_timing.data);
+  return value;
+}
+
 inline size_t LiquidCrystal::write(uint8_t value) {
+  if (_framebuffer) {
+    uint8_t *cell = frameCell(_fbCol, _fbRow);
+    if (cell) {
+      *cell = value;
+    }
+    _fbCol += (_displaymode & LCD_ENTRYLEFT) ? 1 : -1;
+    return 1;
+  }
   send(value, HIGH);
   return 1; // assume sucess
 }
 
+// value / 10^decimals right aligned in exactly width cells, all '#'
+// when it doesn't fit. Rendered on the stack, then only the cells that
+// differ from what the display shows are sent (or in framebuffer mode
+// changed in the framebuffer). Returns how many that was.
+uint8_t LiquidCrystal::printNumber(uint8_t col, uint8_t row, uint8_t width,
+                                   int32_t value, uint8_t decimals) {
+  char cells[LCD_MAX_COLS];
+  if (width > LCD_MAX_COLS) {
+    width = LCD_MAX_COLS;
+  }
+  formatNumber(cells, width, value, decimals);
+  return writeField(col, row, cells, width);
+}
+
+// value in width upper case hex digits, zero padded, '#'s when it
+// doesn't fit. Only changed cells are sent, like printNumber().
+uint8_t LiquidCrystal::printHex(uint8_t col, uint8_t row, uint8_t width, uint32_t value) {
+  char cells[LCD_MAX_COLS];
+  if (width > LCD_MAX_COLS) {
+    width = LCD_MAX_COLS;
+  }
+  formatHex(cells, width, value);
+  return writeField(col, row, cells, width);
+}
+
+// text left aligned in width cells, blank padded or cut off
+uint8_t LiquidCrystal::printText(uint8_t col, uint8_t row, uint8_t width, const char *text) {
+  char cells[LCD_MAX_COLS];
+  uint8_t i = 0;
+  if (width > LCD_MAX_COLS) {
+    width = LCD_MAX_COLS;
+  }
+  for (; i < width && text[i]; i++) {
+    cells[i] = text[i];
+  }
+  memset(cells + i, ' ', width - i);
+  return writeField(col, row, cells, width);
+}
+
+// The cells printNumber() and printHex() show, for callers that keep
+// the text themselves. No terminating 0.
+void LiquidCrystal::formatNumber(char *cells, uint8_t width, int32_t value, uint8_t decimals) {
+  uint32_t magnitude = value < 0 ? -(uint32_t)value : value;
+  uint8_t digits = 0;
+  int8_t i = width;
+  bool fits = true;
+
+  // right to left, with at least one digit before the point
+  do {
+    if (decimals && digits == decimals) {
+      if (i == 0) {
+        fits = false;
+        break;
+      }
+      cells[--i] = '.';
+    }
+    if (i == 0) {
+      fits = false;
+      break;
+    }
+    cells[--i] = '0' + magnitude % 10;
+    magnitude /= 10;
+    digits++;
+  } while (magnitude || digits <= decimals);
+
+  if (fits && value < 0) {
+    if (i == 0) {
+      fits = false;
+    }
+    else {
+      cells[--i] = '-';
+    }
+  }
+  if (fits) {
+    memset(cells, ' ', i);
+  }
+  else {
+    memset(cells, '#', width);
+  }
+}
+
+void LiquidCrystal::formatHex(char *cells, uint8_t width, uint32_t value) {
+  for (int8_t i = width - 1; i >= 0; i--) {
+    cells[i] = "0123456789ABCDEF"[value & 0x0F];
+    value >>= 4;
+  }
+  if (value) {
+    memset(cells, '#', width);
+  }
+}
+
 /************ low level data pushing commands **********/
 
-// write either command or data, with automatic 4/8-bit selection
+// framebuffer cell at col, row, or 0 when that is off the screen
+uint8_t *LiquidCrystal::frameCell(uint8_t col, uint8_t row) {
+  if (col >= _cols || col >= LCD_MAX_COLS || row >= LCD_MAX_ROWS) {
+    return 0;
+  }
+  return &_frame[row * LCD_MAX_COLS + col];
+}
+
+// _glass cell that shows DDRAM address addr, or 0 when it is off the
+// screen
+uint8_t *LiquidCrystal::glassCell(uint8_t addr) {
+  for (uint8_t row = 0; row < _numlines && row < LCD_MAX_ROWS; row++) {
+    uint8_t col = addr - row_offsets[row];
+    if (col < _cols && col < LCD_MAX_COLS) {
+      return &_glass[row * LCD_MAX_COLS + col];
+    }
+  }
+  return 0;
+}
+
+// Put width cells at col, row, skipping the ones already showing.
+// Returns how many cells changed.
+uint8_t LiquidCrystal::writeField(uint8_t col, uint8_t row, const char *cells, uint8_t width) {
+  uint8_t changed = 0;
+  if (row >= LCD_MAX_ROWS) {
+    return 0;
+  }
+  for (uint8_t i = 0; i < width; i++) {
+    uint8_t value = cells[i];
+    if (_framebuffer) {
+      uint8_t *cell = frameCell(col + i, row);
+      if (cell && *cell != value) {
+        *cell = value;  // flush() sends it
+        changed++;
+      }
+      continue;
+    }
+    uint8_t addr = lcdDdramAddress(col + i, row);
+    uint8_t *cell = glassCell(addr);
+    if (_glassValid && cell && *cell == value) {
+      continue;
+    }
+    send(LCD_SETDDRAMADDR | addr, LOW);  // skipped when the cursor is already there
+    send(value, HIGH);
+    changed++;
+  }
+  return changed;
+}
+
+// write either command or data, and wait for the LCD to execute it
+// (or queue it in async mode)
 void LiquidCrystal::send(uint8_t value, uint8_t mode) {
-  if (_usingSpi == false)
-  {
-    digitalWrite(_rs_pin, mode);
+  LCD_STAT(_stats.sends++);
+  if (track(value, mode)) {
+    _skipped++;
+    return;
+  }
+  LCD_STAT(uint32_t cycles = LCD_CYCLE_COUNTER());
+  post(value | (mode ? LCD_QUEUE_DATA : 0));
+  LCD_STAT(record(mode ? _stats.dataCycles : _stats.commandCycles, cycles));
+}
 
-    // if there is a RW pin indicated, set it low to Write
-    if (_rw_pin != 255) { 
-      digitalWrite(_rw_pin, LOW);
+// Follow what value does to the controller's registers and address
+// counter. Returns true for a command that would change nothing.
+bool LiquidCrystal::track(uint8_t value, uint8_t mode) {
+  if (mode) {
+    if (_cgramAddr == 0xFF) {
+      if (value < 16) {
+        _glyphShown |= 1 << (value & 0x07); // a custom character on screen
+      }
+      uint8_t *cell = _ddramAddr == 0xFF ? 0 : glassCell(_ddramAddr);
+      if (cell) {
+        *cell = value;
+      }
+      else if (_ddramAddr == 0xFF) {
+        _glassValid = false;  // went somewhere unknown
+      }
+    }
+    if (_lcdEntry & LCD_ENTRYSHIFTINCREMENT) {
+      _lcdShifted = true;
+    }
+    moveAddress(_lcdEntry & LCD_ENTRYLEFT);
+    return false;
+  }
+  if (value & LCD_SETDDRAMADDR) {
+    uint8_t addr = value & 0x7F;
+    if (addr == _ddramAddr) {
+      return true;
+    }
+    _ddramAddr = addr;
+    _cgramAddr = 0xFF;
+  }
+  else if (value & LCD_SETCGRAMADDR) {
+    uint8_t addr = value & 0x3F;
+    if (addr == _cgramAddr) {
+      return true;
+    }
+    _cgramAddr = addr;
+    _ddramAddr = 0xFF;
+  }
+  else if (value & LCD_FUNCTIONSET) {
+    if (value == _lcdFunction) {
+      return true;
+    }
+    _lcdFunction = value;
+  }
+  else if (value & LCD_CURSORSHIFT) {
+    if (value & LCD_DISPLAYMOVE) {
+      _lcdShifted = true;
+    }
+    else {
+      moveAddress(value & LCD_MOVERIGHT);
+    }
+  }
+  else if (value & LCD_DISPLAYCONTROL) {
+    if (value == _lcdControl) {
+      return true;
+    }
+    _lcdControl = value;
+  }
+  else if (value & LCD_ENTRYMODESET) {
+    if (value == _lcdEntry) {
+      return true;
+    }
+    _lcdEntry = value;
+  }
+  else if (value & LCD_RETURNHOME) {
+    if (_ddramAddr == 0 && !_lcdShifted) {
+      return true;
+    }
+    _ddramAddr = 0;
+    _cgramAddr = 0xFF;
+    _lcdShifted = false;
+  }
+  else if (value & LCD_CLEARDISPLAY) {
+    _ddramAddr = 0;
+    _cgramAddr = 0xFF;
+    _lcdShifted = false;
+    _glyphShown = 0;
+    memset(_glass, ' ', sizeof(_glass));
+    _glassValid = true;
+    if (_lcdEntry != 0xFF) {
+      _lcdEntry |= LCD_ENTRYLEFT; // clear also sets I/D
+    }
+  }
+  return false;
+}
+
+// Step the address counter the way the controller does after a write.
+// DDRAM rows are 0x00-0x27 and 0x40-0x67 in 2-line mode, with 20x4
+// rows 2 and 3 continuing rows 0 and 1 at 0x14 and 0x54, so the
+// counter wraps 0x27 -> 0x40 and 0x67 -> 0x00; 1-line is 0x00-0x4F.
+void LiquidCrystal::moveAddress(bool up) {
+  if (_lcdEntry == 0xFF) {
+    _ddramAddr = 0xFF;
+    _cgramAddr = 0xFF;
+    return;
+  }
+  if (_cgramAddr != 0xFF) {
+    _cgramAddr = (_cgramAddr + (up ? 1 : -1)) & 0x3F;
+  }
+  if (_ddramAddr == 0xFF) {
+    return;
+  }
+  if (_displayfunction & LCD_2LINE) {
+    if (up) {
+      _ddramAddr = _ddramAddr == 0x27 ? 0x40 : _ddramAddr == 0x67 ? 0x00 : _ddramAddr + 1;
+    }
+    else {
+      _ddramAddr = _ddramAddr == 0x00 ? 0x67 : _ddramAddr == 0x40 ? 0x27 : _ddramAddr - 1;
+    }
+  }
+  else {
+    _ddramAddr = up ? (_ddramAddr == 0x4F ? 0x00 : _ddramAddr + 1) :
+                      (_ddramAddr == 0x00 ? 0x4F : _ddramAddr - 1);
+  }
+}
+
+// nothing is known about the controller (power up, begin())
+void LiquidCrystal::forget(void) {
+  _ddramAddr = 0xFF;
+  _cgramAddr = 0xFF;
+  _lcdFunction = 0xFF;
+  _lcdControl = 0xFF;
+  _lcdEntry = 0xFF;
+  _lcdShifted = true;
+}
+
+void LiquidCrystal::post(uint16_t entry) {
+  if (_async) {
+    uint8_t next = (_qTail + 1) & (LCD_QUEUE_SIZE - 1);
+    while (next == _qHead) {
+      if (_bus) {
+        _bus->poll(); // full, make room and keep the others going
+      }
+      else {
+        poll(); // full, make room
+      }
     }
+    _queue[_qTail] = entry;
+    _qTail = next;
+    return;
+  }
+  transmit(entry);
+  settle(entry);
+}
+
+// how long the LCD needs before it accepts the next command or data
+uint16_t LiquidCrystal::settleTime(uint16_t entry) {
+  if (entry & LCD_QUEUE_WAIT) {
+    uint8_t step = entry & 0xFF;
+    return step == LCD_WAIT_POWERUP ? _timing.powerUp :
+           step == LCD_WAIT_RESET ? _timing.reset : _timing.init;
+  }
+  if (entry & (LCD_QUEUE_LATCH | LCD_QUEUE_NIBBLE | LCD_QUEUE_READY)) {
+    return 0; // init nibbles are followed by a wait
+  }
+  if (entry & LCD_QUEUE_DATA) {
+    return _timing.data;
+  }
+  uint8_t value = entry & 0xFF;
+  if (value == LCD_CLEARDISPLAY) {
+    return _timing.clear; // clear and home take a long time!
+  }
+  if ((value & ~0x01) == LCD_RETURNHOME) {
+    return _timing.home;
+  }
+  return _timing.command;
+}
+
+// Wait until the LCD is done with entry. With RW wired that is as soon
+// as the busy flag clears, but never longer than the timed wait.
+void LiquidCrystal::settle(uint16_t entry) {
+  LCD_STAT(uint32_t cycles = LCD_CYCLE_COUNTER());
+  if (_i2c) {
+    uint16_t us = settleTime(entry);
+    if (us > LCD_I2C_LEAD_IN) {
+      delayMicroseconds(us - LCD_I2C_LEAD_IN);
+    }
+  }
+  else if (_rw_pin == 255 || (entry & LCD_QUEUE_TIMED)) {
+    delayMicroseconds(settleTime(entry));
+  }
+  else {
+    waitReady(settleTime(entry));
+  }
+  LCD_STAT(_stats.waitUs += (LCD_CYCLE_COUNTER() - cycles) / LCD_CYCLES_PER_US);
+}
+
+// Poll the busy flag for up to us microseconds, returns the address counter
+uint8_t LiquidCrystal::waitReady(uint16_t us) {
+  uint32_t start = micros();
+  uint8_t status;
+  while (((status = readByte(LOW)) & 0x80) && (uint32_t)(micros() - start) < us) {
+    ;
+  }
+  return status & 0x7F;
+}
+
+// Read a byte back from the LCD: busy flag and address counter with RS
+// low, DDRAM/CGRAM data with RS high. The data pins become inputs
+// before RW goes high so we never drive against the LCD.
+uint8_t LiquidCrystal::readByte(uint8_t mode) {
+  uint8_t pins = (_displayfunction & LCD_8BITMODE) ? 8 : 4;
+  uint8_t value;
+
+  if (!_dataInput) {
+    dataDirection(true); // until the next write, back to back polls skip this
+  }
+  writeRs(mode);
+  _rwPort->BSRR = _rwMask;
+  LCD_PARALLEL_SETUP();
+  if (pins == 8) {
+    value = readBits(8);
+  } else {
+    value = readBits(4) << 4; // high nibble first
+    value |= readBits(4);
+  }
+  _rwPort->BRR = _rwMask;  // writes rely on RW being left low
+  return value;
+}
+
+// one E pulse, sampling the data ports while E is high
+uint8_t LiquidCrystal::readBits(uint8_t pins) {
+  uint16_t idr[2] = { 0, 0 };
+  uint8_t value = 0;
+  _enablePort->BSRR = _enableMask;
+  LCD_PARALLEL_PULSE();    // data is valid tDDR after E rises
+  idr[0] = _pinPort[0]->IDR;
+  if (_pinPort[1]) {
+    idr[1] = _pinPort[1]->IDR;
+  }
+  _enablePort->BRR = _enableMask;
+  LCD_PARALLEL_PULSE();    // enable cycle must be >1000ns
+  for (uint8_t i = 0; i < pins; i++) {
+    if (idr[(_dataPort >> i) & 0x01] & _dataMask[i]) {
+      bitSet(value, i);
+    }
+  }
+  return value;
+}
+
+// put one queue entry on the bus, with automatic 4/8-bit selection
+void LiquidCrystal::transmit(uint16_t entry) {
+  uint8_t value = entry & 0xFF;
+  uint8_t mode = (entry & LCD_QUEUE_DATA) ? HIGH : LOW;
+
+  if (entry & LCD_QUEUE_LATCH) {
+    if (_usingSpi) {
+      if (_backlight_pin != 255) {
+        bitWrite(_bitString, _backlight_pin, (_backlight & 0x01));
+      }
+      spiSendOut();
+    }
+    return;
+  }
+  if (entry & LCD_QUEUE_NIBBLE) {
+    if (_displayfunction & LCD_8BITMODE) {
+      write8bits(value << 4); // the nibble on DB4-DB7
+    }
+    else {
+      write4bits(value);
+    }
+    return;
+  }
+  if (entry & LCD_QUEUE_READY) {
+    _initialized = true;
+    return;
+  }
+  if (entry & LCD_QUEUE_WAIT) {
+    return;
+  }
+  LCD_STAT(mode ? _stats.data++ : _stats.commands++);
+
+  if (_usingSpi == false)
+  {
+    writeRs(mode);  // RW is already low, readByte() puts it back
     
     if (_displayfunction & LCD_8BITMODE) {
       write8bits(value); 
@@ -358,103 +1334,523 @@ void LiquidCrystal::send(uint8_t value, uint8_t mode) {
   }
   else //we use SPI  ##########################################
   {
+    // encode the whole byte first, then stream it
+    uint8_t frames[6];
+    spiSendFrames(frames, encode(frames, value, mode));
+  }
+}
+
+// Turn a byte into the 595 images that clock it into the LCD.
+// RS must be stable > 40ns before E rises, so it only costs a
+// frame of its own when it actually changes.
+uint8_t LiquidCrystal::encode(uint8_t *frames, uint8_t value, uint8_t mode) {
+  uint8_t n = 0;
+  if (((_bitString >> _rs_pin) & 0x01) != mode) {
     bitWrite(_bitString, _rs_pin, mode); //set RS to mode
-    spiSendOut();
-    
-    // we are not using RW with SPI so we are not even bothering
-    // or 8BITMODE so we go straight to write4bits
-    write4bits(value>>4);
-    write4bits(value);    
+    if (_frameBytes == 2) {
+      frames[n++] = _dataByte;
+    }
+    frames[n++] = _bitString;
   }
+  
+  // we are not using RW with SPI so we are not even bothering
+  if (_frameBytes == 2) {
+    return n + encodeByte(frames + n, value);
+  }
+  n += encodeNibble(frames + n, value >> 4);
+  n += encodeNibble(frames + n, value);
+  return n;
+}
+
+// D4-D7 go out together with E high, and E drops on the next frame.
+// Data only has to be set up > 80ns before E falls, and a whole
+// transfer is longer than the > 450ns enable pulse, so 2 frames
+// per nibble meet the timing.
+uint8_t LiquidCrystal::encodeNibble(uint8_t *frames, uint8_t value) {
+  //we put the four bits into the _bitString, the backlight bit stays put
+  _bitString = (_bitString & ~_nibbleImage[0x0F]) | _nibbleImage[value & 0x0F];
+
+  frames[0] = _bitString | (1 << _enable_pin);
+  frames[1] = _bitString & ~(1 << _enable_pin);
+  return 2;
+}
+
+// Same for cascaded 595s: DB0-DB7 shift out first, into the second
+// 595, then RS/E on the first. Two latched 16-bit frames per byte.
+uint8_t LiquidCrystal::encodeByte(uint8_t *frames, uint8_t value) {
+  _dataByte = value;
+  frames[0] = value;
+  frames[1] = _bitString | (1 << _enable_pin);
+  frames[2] = value;
+  frames[3] = _bitString & ~(1 << _enable_pin);
+  return 4;
+}
+
+// Precompute what each nibble value puts on the wires, so encoding is
+// a load per nibble. For SPI that is D4-D7 on the 595 outputs named by
+// _data_pins[4..7]. For the parallel pins it is the bits to set in each
+// port's BSRR, for the low nibble and in 8-bit mode the high one; call
+// resolvePins() first.
+void LiquidCrystal::buildNibbleTable(void) {
+  for (uint8_t value = 0; value < 16; value++) {
+    if (_usingSpi) {
+      uint8_t image = 0;
+      for (int i = 0; i < 4; i++) {
+        if (value & (1 << i)) {
+          bitSet(image, _data_pins[i + 4]);
+        }
+      }
+      _nibbleImage[value] = image;
+      continue;
+    }
+    for (uint8_t half = 0; half < 2; half++) {
+      uint16_t set[2] = { 0, 0 };
+      for (uint8_t i = 0; i < 4; i++) {
+        uint8_t line = half * 4 + i;
+        if ((value & (1 << i)) && (half == 0 || (_displayfunction & LCD_8BITMODE))) {
+          set[(_dataPort >> line) & 0x01] |= _dataMask[line];
+        }
+      }
+      _pinSet[half][value][0] = set[0];
+      _pinSet[half][value][1] = set[1];
+    }
+  }
+}
+
+// Resolve the parallel pins from PIN_MAP once. The data lines then go
+// out in one BSRR store per port instead of a pinMode() and a
+// digitalWrite() each, and every pin on the Core is on GPIOA or GPIOB,
+// so that is two stores at most. Pin direction only changes around a
+// readByte(), see dataDirection().
+void LiquidCrystal::resolvePins(uint8_t pins) {
+  _pinPort[0] = 0;
+  _pinPort[1] = 0;
+  _portData[0] = 0;
+  _portData[1] = 0;
+  _dataPort = 0;
+  memset(_dataConfig, 0, sizeof(_dataConfig));
+  for (uint8_t i = 0; i < pins; i++) {
+    pinMode(_data_pins[i], OUTPUT);
+    GPIO_TypeDef *port = PIN_MAP[_data_pins[i]].gpio_peripheral;
+    uint8_t p = (_pinPort[0] == 0 || _pinPort[0] == port) ? 0 : 1;
+    _pinPort[p] = port;
+    _dataMask[i] = PIN_MAP[_data_pins[i]].gpio_pin;
+    _portData[p] |= _dataMask[i];
+    if (p) {
+      bitSet(_dataPort, i);
+    }
+    uint8_t bit = 0;
+    while (!(_dataMask[i] & (1 << bit))) {
+      bit++;
+    }
+    _dataConfig[p][bit >> 3] |= 0xFUL << (bit & 0x07) * 4;
+  }
+  _rsPort = PIN_MAP[_rs_pin].gpio_peripheral;
+  _rsMask = PIN_MAP[_rs_pin].gpio_pin;
+  _enablePort = PIN_MAP[_enable_pin].gpio_peripheral;
+  _enableMask = PIN_MAP[_enable_pin].gpio_pin;
+  if (_rw_pin != 255) {
+    _rwPort = PIN_MAP[_rw_pin].gpio_peripheral;
+    _rwMask = PIN_MAP[_rw_pin].gpio_pin;
+  }
+}
+
+// Data lines to floating inputs (0x4) or back to 50MHz push-pull
+// outputs (0x3), the modes pinMode() sets, with one read-modify-write
+// of CRL/CRH per port half they are on. Other pins on those ports keep
+// their configuration.
+void LiquidCrystal::dataDirection(bool input) {
+  uint32_t mode = input ? 0x44444444UL : 0x33333333UL;
+  for (uint8_t p = 0; p < 2 && _pinPort[p]; p++) {
+    if (_dataConfig[p][0]) {
+      _pinPort[p]->CRL = (_pinPort[p]->CRL & ~_dataConfig[p][0]) | (mode & _dataConfig[p][0]);
+    }
+    if (_dataConfig[p][1]) {
+      _pinPort[p]->CRH = (_pinPort[p]->CRH & ~_dataConfig[p][1]) | (mode & _dataConfig[p][1]);
+    }
+  }
+  _dataInput = input;
+}
+
+// RS to mode, one store, then its setup time
+void LiquidCrystal::writeRs(uint8_t mode) {
+  _rsPort->BSRR = mode ? _rsMask : (uint32_t)_rsMask << 16;
+  LCD_PARALLEL_SETUP();
+  LCD_TRACED(bitWrite(_traceLines, 8, mode));
+}
+
+// Put the low pins bits of value on the data lines, then strobe E.
+// BSRR sets the 1s and resets the 0s of a port in the same store.
+void LiquidCrystal::writePins(uint8_t value, uint8_t pins) {
+  if (_dataInput) {
+    dataDirection(false);
+  }
+  const uint16_t *low = _pinSet[0][value & 0x0F];
+  uint16_t set[2] = { low[0], low[1] };
+  if (pins == 8) {
+    set[0] |= _pinSet[1][value >> 4][0];
+    set[1] |= _pinSet[1][value >> 4][1];
+  }
+  _pinPort[0]->BSRR = set[0] | (uint32_t)(_portData[0] & ~set[0]) << 16;
+  if (_pinPort[1]) {
+    _pinPort[1]->BSRR = set[1] | (uint32_t)(_portData[1] & ~set[1]) << 16;
+  }
+  LCD_TRACED(_traceLines = (_traceLines & LCD_TRACE_RS) | (pins == 4 ? (value & 0x0F) << 4 : value));
+  pulseEnable();
 }
 
 void LiquidCrystal::pulseEnable(void) {
+  _enablePort->BSRR = _enableMask;
+  LCD_TRACED(if (_trace) _trace->record(_traceLines | LCD_TRACE_E));
+  delayMicroseconds(1);    // enable pulse must be >450ns
+  _enablePort->BRR = _enableMask;
+  LCD_TRACED(if (_trace) _trace->record(_traceLines));
+  delayMicroseconds(1);    // enable cycle must be >1000ns, 4-bit mode
+                           // sends the second nibble right away
+}
+
+void LiquidCrystal::write4bits(uint8_t value) {
   if (_usingSpi == false)
   {
-    digitalWrite(_enable_pin, LOW);
-    delayMicroseconds(1);
-    digitalWrite(_enable_pin, HIGH);
-    delayMicroseconds(1);    // enable pulse must be >450ns
-    digitalWrite(_enable_pin, LOW);
-    delayMicroseconds(100);   // commands need > 37us to settle
+    writePins(value, 4);
   }
-  else //we use SPI #############################################
+  else //we use SPI ##############################################
   {
-    bitWrite(_bitString, _enable_pin, LOW);
-    spiSendOut();
-    delayMicroseconds(1);
-    bitWrite(_bitString, _enable_pin, HIGH);
-    spiSendOut();
-    delayMicroseconds(1);    // enable pulse must be >450ns
-    bitWrite(_bitString, _enable_pin, LOW);
-    spiSendOut();
-    delayMicroseconds(40);   // commands need > 37us to settle
+    uint8_t frames[2];
+    spiSendFrames(frames, encodeNibble(frames, value));
   }
 }
 
-void LiquidCrystal::write4bits(uint8_t value) {
+void LiquidCrystal::write8bits(uint8_t value) {
   if (_usingSpi == false)
   {
-    for (int i = 0; i < 4; i++) {
-      pinMode(_data_pins[i], OUTPUT);
-      digitalWrite(_data_pins[i], (value >> i) & 0x01);
-    }
+    writePins(value, 8);
   }
   else //we use SPI ##############################################
   {
-    for (int i = 4; i < 8; i++) {
-      //we put the four bits into the _bitString
-      bitWrite(_bitString, _data_pins[i], ((value >> (i - 4)) & 0x01));
-    }
-    // add the backlight bit on all transfers
-    bitWrite(_bitString, _backlight_pin, (_backlight & 0x01));
-    
-    // and send it out
-    spiSendOut();
+    uint8_t frames[4];
+    spiSendFrames(frames, encodeByte(frames, value));
   }
-  pulseEnable();
 }
 
-void LiquidCrystal::write8bits(uint8_t value) {
-  for (int i = 0; i < 8; i++) {
-    pinMode(_data_pins[i], OUTPUT);
-    digitalWrite(_data_pins[i], (value >> i) & 0x01);
+void LiquidCrystal::spiSendOut() //SPI #############################
+{
+  if (_frameBytes == 2) {
+    uint8_t frame[2] = { _dataByte, _bitString };
+    spiSendFrames(frame, 2);
+  }
+  else {
+    spiSendFrames(&_bitString, 1);
   }
-  pulseEnable();
 }
 
-void LiquidCrystal::spiSendOut() //SPI #############################
+// Stream pre-encoded 595 images back to back, one latch per frame of
+// _frameBytes bytes (count is in bytes). With I2C they are all one
+// MCP23008 GPIO write.
+// This is synchronous: the latch needs a GPIO edge after every frame,
+// so frames go out from a tight loop with the latch port resolved once
+// in initSPI() instead of digitalWrite(), and the CPU waits on each one.
+// There is no DMA path.
+void LiquidCrystal::spiSendFrames(const uint8_t *frames, uint8_t count)
 {
-  if(_softSpi) {
-    writeFast(_bitString);
+  LCD_STAT(uint32_t cycles = LCD_CYCLE_COUNTER());
+  LCD_STAT(_stats.transfers++);
+  if (_sendFrames) {
+    _sendFrames(frames, count);
+  }
+  else if (_i2c) {
+    Wire.beginTransmission(MCP23008_ADDRESS | (_latchPin & 0x07));
+    Wire.write(MCP23008_GPIO);
+    for (uint8_t i = 0; i < count; i++) {
+      Wire.write(frames[i]);
+    }
+    Wire.endTransmission();
+  }
+  else if(_softSpi) {
+    lcdSoftSpiSend(_spiPins, frames, count, _frameBytes);
   }
   else {
-    digitalWrite(_latchPin, LOW);
-    SPI.transfer(_bitString);
-    digitalWrite(_latchPin, HIGH);
+    if (_bus && _bus->_owner != this) {
+      _bus->select(this);
+    }
+    uint8_t i = 0;
+    while (i < count) {
+      _spiPins.latchPort->BRR = _spiPins.latchMask;   // Latch Low
+      SPI.transfer(frames[i++]);
+      if (_frameBytes == 2) {
+        SPI.transfer(frames[i++]);
+      }
+      _spiPins.latchPort->BSRR = _spiPins.latchMask;  // Latch High (Data Latched)
+    }
   }
+  LCD_STAT(record(_stats.transferCycles, cycles));
+  LCD_TRACED(traceFrames(frames, count));
 }
 
+#if LCD_TRACE
+// Record what each latched image puts on the LCD's lines
+void LiquidCrystal::traceFrames(const uint8_t *frames, uint8_t count) {
+  if (!_trace) {
+    return;
+  }
+  for (uint8_t i = 0; i < count; i += _frameBytes) {
+    uint8_t image = frames[i + _frameBytes - 1];  // RS and E are on the last 595
+    uint16_t lines = 0;
+    if (_frameBytes == 2) {
+      lines = frames[i];
+    }
+    else {
+      for (uint8_t n = 0; n < 4; n++) {
+        if (image & (1 << _data_pins[n + 4])) {
+          lines |= 0x10 << n;
+        }
+      }
+    }
+    if (image & (1 << _rs_pin)) {
+      lines |= LCD_TRACE_RS;
+    }
+    if (image & (1 << _enable_pin)) {
+      lines |= LCD_TRACE_E;
+    }
+    _trace->record(lines);
+  }
+}
+#endif
+
 void LiquidCrystal::writeSlow(uint8_t value) {
   digitalWrite(_latchPin, LOW);
   shiftOut(_sdatPin, _sclkPin, MSBFIRST, value);
   digitalWrite(_latchPin, HIGH);
 }
 
-inline void LiquidCrystal::writeFast(uint8_t value) {
-  PIN_MAP[_latchPin].gpio_peripheral->BRR = PIN_MAP[_latchPin].gpio_pin; // Latch Low
-  for (uint8_t i = 0; i < 8; i++)  {
-    if (value & (1 << (7-i))) { // walks down mask from bit 7 to bit 0
-      PIN_MAP[_sdatPin].gpio_peripheral->BSRR = PIN_MAP[_sdatPin].gpio_pin; // Data High
-    } 
-    else {
-      PIN_MAP[_sdatPin].gpio_peripheral->BRR = PIN_MAP[_sdatPin].gpio_pin; // Data Low
+// One bit into the 595, MSB first. Data settles before the rising clock
+// edge and the clock is held high for another settle before it drops.
+#define LCD_SOFTSPI_BIT(bit) \
+  if (value & (bit)) { \
+    sdatPort->BSRR = sdatMask;      /* Data High */ \
+  } \
+  else { \
+    sdatPort->BRR = sdatMask;       /* Data Low */ \
+  } \
+  LCD_SOFTSPI_SETTLE(); \
+  sclkPort->BSRR = sclkMask;        /* Clock High (Data Shifted In) */ \
+  LCD_SOFTSPI_SETTLE(); \
+  sclkPort->BRR = sclkMask;         /* Clock Low */
+
+// Same with clock and data on one port: the data level and the falling
+// clock edge go out in a single BSRR store, two stores per bit.
+#define LCD_SOFTSPI_BIT_SHARED(bit) \
+  sclkPort->BSRR = (value & (bit)) ? dataHigh : dataLow; \
+  LCD_SOFTSPI_SETTLE(); \
+  sclkPort->BSRR = sclkMask;        /* Clock High (Data Shifted In) */ \
+  LCD_SOFTSPI_SETTLE();
+
+// Unrolled software SPI, one latch per frame of width bytes, with the
+// ports and masks resolved once instead of indexing PIN_MAP for every bit.
+void lcdSoftSpiSend(const LcdSpiPins &pins, const uint8_t *frames, uint8_t count, uint8_t width) {
+  GPIO_TypeDef *latchPort = pins.latchPort;
+  GPIO_TypeDef *sclkPort = pins.sclkPort;
+  GPIO_TypeDef *sdatPort = pins.sdatPort;
+  uint16_t latchMask = pins.latchMask;
+  uint16_t sclkMask = pins.sclkMask;
+  uint16_t sdatMask = pins.sdatMask;
+
+  if (sclkPort == sdatPort) {
+    uint32_t dataHigh = sdatMask | ((uint32_t)sclkMask << 16);
+    uint32_t dataLow = (uint32_t)(sdatMask | sclkMask) << 16;
+    while (count) {
+      latchPort->BRR = latchMask;   // Latch Low
+      for (uint8_t b = width; b; b--, count--) {
+        uint8_t value = *frames++;
+        LCD_SOFTSPI_BIT_SHARED(0x80);
+        LCD_SOFTSPI_BIT_SHARED(0x40);
+        LCD_SOFTSPI_BIT_SHARED(0x20);
+        LCD_SOFTSPI_BIT_SHARED(0x10);
+        LCD_SOFTSPI_BIT_SHARED(0x08);
+        LCD_SOFTSPI_BIT_SHARED(0x04);
+        LCD_SOFTSPI_BIT_SHARED(0x02);
+        LCD_SOFTSPI_BIT_SHARED(0x01);
+      }
+      latchPort->BSRR = latchMask;  // Latch High (Data Latched)
+    }
+    sclkPort->BRR = sclkMask;       // Clock Low
+  }
+  else {
+    while (count) {
+      latchPort->BRR = latchMask;   // Latch Low
+      for (uint8_t b = width; b; b--, count--) {
+        uint8_t value = *frames++;
+        LCD_SOFTSPI_BIT(0x80);
+        LCD_SOFTSPI_BIT(0x40);
+        LCD_SOFTSPI_BIT(0x20);
+        LCD_SOFTSPI_BIT(0x10);
+        LCD_SOFTSPI_BIT(0x08);
+        LCD_SOFTSPI_BIT(0x04);
+        LCD_SOFTSPI_BIT(0x02);
+        LCD_SOFTSPI_BIT(0x01);
+      }
+      LCD_SOFTSPI_SETTLE();
+      latchPort->BSRR = latchMask;  // Latch High (Data Latched)
+    }
+  }
+}
+
+/*********** shared SPI bus */
+
+LiquidCrystalBus::LiquidCrystalBus()
+{
+  _count = 0;
+  _owner = 0;
+  _loaded = false;
+  _changes = 0;
+}
+
+// Call after the display's initSPI() (or parallel constructor). The
+// display switches to async mode; begin(), print() etc. queue and
+// poll() here sends them. Returns false when the bus is full.
+bool LiquidCrystalBus::attach(LiquidCrystal &lcd)
+{
+  if (_count == LCD_BUS_MAX) {
+    return false;
+  }
+  _lcds[_count++] = &lcd;
+  lcd._bus = this;
+  lcd.async();
+  _loaded = false; // initSPI() set up SPI behind our back
+  _owner = 0;
+  return true;
+}
+
+// Send whatever each display can take right now. A display waiting out
+// a command doesn't hold up the others, so N displays refresh in about
+// the time of one instead of N times as long.
+void LiquidCrystalBus::poll()
+{
+  for (uint8_t i = 0; i < _count; i++) {
+    _lcds[i]->poll();
+  }
+}
+
+// Wait until every display has sent and executed everything queued
+void LiquidCrystalBus::flushBlocking()
+{
+  bool busy = true;
+  while (busy) {
+    busy = false;
+    for (uint8_t i = 0; i < _count; i++) {
+      busy |= _lcds[i]->queueDepth() != 0;
+    }
+    poll();
+  }
+  for (uint8_t i = 0; i < _count; i++) {
+    _lcds[i]->flushBlocking();
+  }
+}
+
+// Another SPI user (SD card, radio...) is about to change the SPI
+// settings, the next display transfer restores ours
+void LiquidCrystalBus::release()
+{
+  _loaded = false;
+  _owner = 0;
+}
+
+uint32_t LiquidCrystalBus::settingChanges()
+{
+  return _changes;
+}
+
+// Switch the bus to lcd, only touching SPI when its settings differ
+// from what's loaded
+void LiquidCrystalBus::select(LiquidCrystal *lcd)
+{
+  _owner = lcd;
+  if (_loaded && lcd->_clockDivider == _clockDivider &&
+      lcd->_dataMode == _dataMode && lcd->_bitOrder == _bitOrder) {
+    return;
+  }
+  _clockDivider = lcd->_clockDivider;
+  _dataMode = lcd->_dataMode;
+  _bitOrder = lcd->_bitOrder;
+  SPI.setClockDivider(_clockDivider);
+  SPI.setDataMode(_dataMode);
+  SPI.setBitOrder(_bitOrder);
+  _loaded = true;
+  _changes++;
+}
+
+/*********** bus trace */
+
+LiquidCrystalTrace::LiquidCrystalTrace(LCDTraceFrame *frames, uint16_t size)
+{
+  _frames = frames;
+  _size = size;
+  _count = 0;
+  _overflowed = false;
+  _eightBit = true;  // the controller powers up in 8-bit mode
+  _highNibble = false;
+  _nibble = 0;
+  _enable = false;
+}
+
+void LiquidCrystalTrace::record(uint16_t lines)
+{
+  if (_count == _size) {
+    _overflowed = true;
+    return;
+  }
+  _frames[_count].us = micros();
+  _frames[_count].lines = lines;
+  _count++;
+}
+
+uint16_t LiquidCrystalTrace::count()
+{
+  return _count;
+}
+
+bool LiquidCrystalTrace::overflowed()
+{
+  return _overflowed;
+}
+
+const LCDTraceFrame &LiquidCrystalTrace::frame(uint16_t i)
+{
+  return _frames[i];
+}
+
+// Decode the frames recorded so far into at most max bytes, then make
+// room for more. Returns how many bytes were stored.
+uint16_t LiquidCrystalTrace::decode(uint16_t *bytes, uint16_t max)
+{
+  uint16_t n = 0;
+  for (uint16_t i = 0; i < _count; i++) {
+    uint16_t lines = _frames[i].lines;
+    bool enable = lines & LCD_TRACE_E;
+    if (_enable && !enable) {
+      uint8_t value = lines & 0xFF;
+      bool complete = true;
+      if (!_eightBit && !_highNibble) {
+        _nibble = value & 0xF0;  // DB4-DB7, high nibble first
+        _highNibble = true;
+        complete = false;
+      }
+      else if (!_eightBit) {
+        value = _nibble | value >> 4;
+        _highNibble = false;
+      }
+      if (complete) {
+        if (!(lines & LCD_TRACE_RS) && (value & 0xE0) == LCD_FUNCTIONSET) {
+          _eightBit = value & LCD_8BITMODE;
+        }
+        if (n < max) {
+          bytes[n++] = value | (lines & LCD_TRACE_RS);
+        }
+      }
     }
-    asm volatile("mov r0, r0" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" ::: "r0", "cc", "memory");
-    PIN_MAP[_sclkPin].gpio_peripheral->BSRR = PIN_MAP[_sclkPin].gpio_pin; // Clock High (Data Shifted In)
-    asm volatile("mov r0, r0" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" ::: "r0", "cc", "memory");
-    PIN_MAP[_sclkPin].gpio_peripheral->BRR = PIN_MAP[_sclkPin].gpio_pin; // Clock Low
+    _enable = enable;
   }
-  asm volatile("mov r0, r0" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" ::: "r0", "cc", "memory");
-  PIN_MAP[_latchPin].gpio_peripheral->BSRR = PIN_MAP[_latchPin].gpio_pin; // Latch High (Data Latched)
-}
\ No newline at end of file
+  _count = 0;
+  _overflowed = false;
+  return n;
+}
@@ -22,6 +22,59 @@
 #define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
 #define bitWrite(value, bit, bitvalue) (bitvalue ? bitSet(value, bit) : bitClear(value, bit))
 
+// Software SPI settle time between data, clock and latch edges.
+// The host simulation build (host/application.h) supplies its own.
+#ifndef LCD_SOFTSPI_SETTLE
+#define LCD_SOFTSPI_SETTLE() asm volatile("mov r0, r0" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" ::: "r0", "cc", "memory")
+#endif
+
+// RS/RW setup before E rises on the parallel pins, > 40ns: the same
+// four cycles
+#ifndef LCD_PARALLEL_SETUP
+#define LCD_PARALLEL_SETUP() LCD_SOFTSPI_SETTLE()
+#endif
+
+// E high for a busy flag read, and low before the next one: > 450ns
+// (PWEH) and > 360ns (tDDR) at 3.3V, 36 cycles
+#ifndef LCD_PARALLEL_PULSE
+#define LCD_PARALLEL_PULSE() \
+  do { for (uint8_t _nop = 0; _nop < 9; _nop++) LCD_PARALLEL_SETUP(); } while (0)
+#endif
+
+// Build with -DLCD_STATS=1 for getStats(). Off, the counting compiles
+// to nothing and getStats() returns zeros.
+#ifndef LCD_STATS
+#define LCD_STATS 0
+#endif
+
+#if LCD_STATS
+#define LCD_STAT(x) x
+#else
+#define LCD_STAT(x)
+#endif
+
+// Build with -DLCD_TRACE=1 for trace(). Off, nothing is recorded.
+#ifndef LCD_TRACE
+#define LCD_TRACE 0
+#endif
+
+#if LCD_TRACE
+#define LCD_TRACED(x) x
+#else
+#define LCD_TRACED(x)
+#endif
+
+// Cortex-M3 DWT cycle counter for the latency histograms. The host
+// simulation build supplies its own.
+#ifndef LCD_CYCLE_COUNTER
+#define LCD_CYCLE_COUNTER_START() do { \
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; \
+  } while (0)
+#define LCD_CYCLE_COUNTER() (DWT->CYCCNT)
+#define LCD_CYCLES_PER_US (SystemCoreClock / 1000000)
+#endif
+
 /* ========= LiquidCrystalSPI.h ========== */
 
 // commands
@@ -62,6 +115,67 @@
 #define LCD_5x10DOTS 0x04
 #define LCD_5x8DOTS 0x00
 
+// async mode queue entries, a power of 2
+#define LCD_QUEUE_SIZE 64
+
+// displays one LiquidCrystalBus can share the SPI bus between
+#define LCD_BUS_MAX 4
+
+// framebuffer size, large enough for a 20x4 display
+#define LCD_MAX_COLS 20
+#define LCD_MAX_ROWS 4
+
+// Controller timing in microseconds, select one with setTiming()
+struct LCDTiming {
+  uint16_t powerUp;  // after VCC rises, before the first nibble
+  uint16_t reset;    // after the first init nibble (8-bit function set)
+  uint16_t init;     // between the other steps of begin()
+  uint16_t clear;    // clear display
+  uint16_t home;     // return home
+  uint16_t command;  // any other instruction
+  uint16_t data;     // DDRAM/CGRAM write
+};
+
+extern const LCDTiming LCD_TIMING_HD44780;      // HD44780 and compatible LCDs (default)
+extern const LCDTiming LCD_TIMING_WINSTAR_OLED; // Winstar WEH/WEG OLEDs (WS0010)
+extern const LCDTiming LCD_TIMING_ADH_OLED;     // Sparkfun / ADH Technology OLEDs
+
+// latency histogram bins: bin 0 counts < 256 cycles (3.5us on the
+// Core), each bin doubles that, the last one takes everything longer
+#define LCD_STATS_BINS 12
+
+// Where the time goes, see getStats()
+struct LCDStats {
+  uint32_t sends;       // send() calls, skipped commands included
+  uint32_t commands;    // instruction bytes put on the bus
+  uint32_t data;        // DDRAM/CGRAM bytes put on the bus
+  uint32_t transfers;   // SPI/I2C bursts, one per spiSendFrames()
+  uint32_t waitUs;      // waiting for the LCD after a byte, blocking mode
+  uint32_t commandCycles[LCD_STATS_BINS]; // one command, start to settled
+  uint32_t dataCycles[LCD_STATS_BINS];    // one character
+  uint32_t transferCycles[LCD_STATS_BINS]; // one burst
+};
+
+// 595 latch and software SPI pins resolved from PIN_MAP
+struct LcdSpiPins {
+  GPIO_TypeDef *latchPort;
+  GPIO_TypeDef *sclkPort;
+  GPIO_TypeDef *sdatPort;
+  uint16_t latchMask;
+  uint16_t sclkMask;
+  uint16_t sdatMask;
+};
+
+// Shift out count bytes of 595 frames, width bytes per latch
+void lcdSoftSpiSend(const LcdSpiPins &pins, const uint8_t *frames, uint8_t count, uint8_t width);
+
+// Puts 595 frames on the bus in place of the built in transports,
+// see liquid-crystal-spi-t.h
+typedef void (*LcdFrameSender)(const uint8_t *frames, uint8_t count);
+
+class LiquidCrystalBus;
+class LiquidCrystalTrace;
+
 class LiquidCrystal : public Print {
 public:
   LiquidCrystal(uint8_t rs, uint8_t enable,
@@ -77,12 +191,16 @@ public:
   LiquidCrystal(uint8_t ss, uint8_t sclk=255, uint8_t sdat=255); //SPI to ShiftRegister 74HC595 ##########
 
   void initSPI(void); //SPI ##################################
+  void initSPI16(void); // two cascaded 595s, 8-bit mode
+  void initI2C(void);   // backpack in I2C mode, MCP23008 at 0x20 + ss (0-7)
+  void setClockDivider(uint8_t);
 
   void init(uint8_t fourbitmode, uint8_t rs, uint8_t rw, uint8_t enable,
       uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3,
       uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7, uint8_t backlight);
     
   void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS);
+  void setTiming(const LCDTiming &);
 
   void clear();
   void home();
@@ -101,45 +219,232 @@ public:
   void noAutoscroll();
   void backlight();
   void noBacklight();
+  void framebuffer();
+  void noFramebuffer();
+  void flush();
+  void async();
+  void noAsync();
+  void poll();
+  void flushBlocking();
+  uint8_t queueDepth();
+  bool ready();
 
   void createChar(uint8_t, uint8_t[]);
+  void createChar(uint8_t, const uint8_t[]);
+  uint8_t glyph(uint16_t, const uint8_t[]);
+  size_t writeGlyph(uint16_t, const uint8_t[]);
+  uint8_t printNumber(uint8_t col, uint8_t row, uint8_t width, int32_t value, uint8_t decimals = 0);
+  uint8_t printHex(uint8_t col, uint8_t row, uint8_t width, uint32_t value);
+  uint8_t printText(uint8_t col, uint8_t row, uint8_t width, const char *text);
+  static void formatNumber(char *cells, uint8_t width, int32_t value, uint8_t decimals = 0);
+  static void formatHex(char *cells, uint8_t width, uint32_t value);
+  uint32_t glyphHits();
+  uint32_t glyphMisses();
   void setCursor(uint8_t, uint8_t); 
   virtual size_t write(uint8_t);
+  using Print::write;
   void command(uint8_t);
+  uint8_t readAddress();
+  uint8_t read();
+  uint32_t skippedCommands();
+  const LCDStats &getStats();
+  void resetStats();
+  void trace(LiquidCrystalTrace *);
+protected:
+  void initFrames(LcdFrameSender, uint8_t rs, uint8_t enable,
+                  uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7, uint8_t backlight);
 private:
+  friend class LiquidCrystalBus;
   void send(uint8_t, uint8_t);
+  void post(uint16_t);
+  void transmit(uint16_t);
+  uint16_t settleTime(uint16_t);
+  void settle(uint16_t);
+  bool track(uint8_t, uint8_t);
+  void forget();
+  void forgetGlyphs();
+  uint8_t visibleGlyphs();
+  void moveAddress(bool);
+  bool canSend();
+  uint8_t waitReady(uint16_t);
+  uint8_t readByte(uint8_t);
+  uint8_t readBits(uint8_t);
   void spiSendOut();      // SPI ###########################################
+  void spiSendFrames(const uint8_t *, uint8_t);
+  uint8_t encode(uint8_t *, uint8_t, uint8_t);
+  uint8_t encodeNibble(uint8_t *, uint8_t);
+  uint8_t encodeByte(uint8_t *, uint8_t);
+  void buildNibbleTable();
+  void resolvePins(uint8_t);
+  void writeRs(uint8_t);
+  void dataDirection(bool);
+  void writePins(uint8_t, uint8_t);
   void write4bits(uint8_t);
   void write8bits(uint8_t);
   void pulseEnable();
   void writeSlow(uint8_t);
-  void writeFast(uint8_t);
+  uint8_t *frameCell(uint8_t, uint8_t);
+  uint8_t *glassCell(uint8_t);
+  uint8_t writeField(uint8_t, uint8_t, const char *, uint8_t);
+#if LCD_STATS
+  void record(uint32_t *, uint32_t);
+#endif
+#if LCD_TRACE
+  void traceFrames(const uint8_t *, uint8_t);
+#endif
   
   uint8_t _rs_pin;        // LOW: command.  HIGH: character.
   uint8_t _rw_pin;        // LOW: write to LCD.  HIGH: read from LCD.
   uint8_t _enable_pin;    // activated by a HIGH pulse.
   uint8_t _backlight_pin; // activated by a HIGH pulse (adafruit SPI/I2C LCD Backpack only)
   uint8_t _data_pins[8];
+  bool    _dataInput;     // data pins left as inputs by the last readByte()
+  GPIO_TypeDef *_pinPort[2]; // ports the data pins are on, see resolvePins()
+  uint16_t _portData[2];  // data lines in use on each port
+  uint16_t _dataMask[8];  // data line i on its port
+  uint8_t  _dataPort;     // bit i set: data line i is on _pinPort[1]
+  uint32_t _dataConfig[2][2]; // data line fields in each port's CRL, CRH
+  GPIO_TypeDef *_rsPort;  // RS, RW and E resolved from PIN_MAP
+  GPIO_TypeDef *_rwPort;
+  GPIO_TypeDef *_enablePort;
+  uint16_t _rsMask;
+  uint16_t _rwMask;
+  uint16_t _enableMask;
   
   //SPI #####################################################################
   uint8_t _backlight; // 1 = backlight on, 0 = backlight off
   uint8_t _bitString; //for SPI  bit0=not used, bit1=RS, bit2=RW, bit3=Enable, bits4-7 = DB4-7
+  uint8_t _dataByte;  // DB0-7 on the second 595 with initSPI16()
+  uint8_t _frameBytes; // bytes shifted per latch, 1 or 2 with cascaded 595s
+  uint8_t _nibbleImage[16]; // D4-D7 lines for each nibble value, see buildNibbleTable()
+  uint16_t _pinSet[2][16][2]; // parallel: BSRR bits per port for a low/high nibble
   bool    _usingSpi;  //to let send and write functions know we are using SPI 
   bool    _softSpi;   //to let send and write functions know we are using SPI 
+  bool    _i2c;       //same _bitString images, sent to an MCP23008 instead
   uint8_t _latchPin;
   uint8_t _sclkPin;
   uint8_t _sdatPin;
+  LcdSpiPins _spiPins;     // resolved by initSPI()
+  LcdFrameSender _sendFrames; // set by initFrames(), 0 for the built in transports
   uint8_t _clockDivider;
   uint8_t _dataMode;
   uint8_t _bitOrder;//SPI ####################################################
+  LiquidCrystalBus *_bus; // shared with other displays, 0 when we own the bus
   
   uint8_t _displayfunction;
   uint8_t _displaycontrol;
   uint8_t _displaymode;
 
-  uint8_t _initialized;
+  volatile uint8_t _initialized; // begin() sequence done
 
   uint8_t _numlines,_currline;
+  uint8_t _cols;
+  LCDTiming _timing;
+
+  //Framebuffer ############################################################
+  bool    _framebuffer;  // write() and print() only update _frame until flush()
+  bool    _glassValid;   // _glass really is what the LCD shows, track() keeps it
+  uint8_t _fbCol;        // framebuffer cursor
+  uint8_t _fbRow;
+  uint8_t _frame[LCD_MAX_ROWS * LCD_MAX_COLS]; // what the application wants shown
+  uint8_t _glass[LCD_MAX_ROWS * LCD_MAX_COLS]; // what the LCD is showing
+
+  //Controller state #######################################################
+  uint8_t _ddramAddr;    // address counter if known and in DDRAM, 0xFF otherwise
+  uint8_t _cgramAddr;    // address counter if known and in CGRAM, 0xFF otherwise
+  uint8_t _lcdFunction;  // last function set / display control / entry mode
+  uint8_t _lcdControl;   // sent, 0xFF when unknown
+  uint8_t _lcdEntry;
+  bool    _lcdShifted;   // display may be shifted, home() isn't a no-op
+  uint32_t _skipped;     // commands not sent because they changed nothing
+
+#if LCD_STATS
+  LCDStats _stats;
+#endif
+#if LCD_TRACE
+  LiquidCrystalTrace *_trace; // records what goes out, 0 when off
+  uint16_t _traceLines;       // parallel RS and data lines
+#endif
+
+  //Glyph cache ############################################################
+  uint16_t _glyphId[8];    // glyph() id in each CGRAM slot
+  uint16_t _glyphHash[8];  // hash of id and bitmap, 0 when the slot is free
+  uint16_t _glyphUsed[8];  // _glyphClock when it was last asked for
+  uint16_t _glyphClock;
+  uint8_t  _glyphShown;    // slots written to DDRAM since the last clear
+  uint32_t _glyphHits;
+  uint32_t _glyphMisses;
+
+  //Async ##################################################################
+  bool     _async;         // send() queues instead of waiting
+  volatile bool _polling;  // poll() is running (loop() vs timer interrupt)
+  volatile uint8_t _qHead; // next entry poll() sends
+  volatile uint8_t _qTail; // next free entry
+  uint32_t _qDeadline;     // micros() when the LCD accepts the next entry
+  bool     _qTimed;        // last entry can't be cut short by the busy flag
+  uint16_t _queue[LCD_QUEUE_SIZE]; // value | LCD_QUEUE_* flags
+};
+
+// Several displays on one SPI bus, each 595 with its own latch pin.
+// Attached displays run in async mode and poll() services all of them,
+// so one display's settle time is spent sending to the others.
+class LiquidCrystalBus {
+public:
+  LiquidCrystalBus();
+
+  bool attach(LiquidCrystal &);
+  void poll();
+  void flushBlocking();
+  void release();
+  uint32_t settingChanges();
+private:
+  friend class LiquidCrystal;
+  void select(LiquidCrystal *);
+
+  LiquidCrystal *_lcds[LCD_BUS_MAX];
+  uint8_t _count;
+  LiquidCrystal *_owner;   // whose transfers went out last
+  bool    _loaded;         // SPI holds the settings below
+  uint8_t _clockDivider;
+  uint8_t _dataMode;
+  uint8_t _bitOrder;
+  uint32_t _changes;       // times the SPI settings were rewritten
+};
+
+// trace frame lines, DB0-DB7 are the low byte (DB4-DB7 in 4-bit mode)
+#define LCD_TRACE_RS 0x0100
+#define LCD_TRACE_E  0x0200
+
+// What the LCD's lines looked like after one 595 or MCP23008 latch,
+// or one E edge on the parallel pins
+struct LCDTraceFrame {
+  uint32_t us;     // micros() when it went out
+  uint16_t lines;  // DB0-DB7 | LCD_TRACE_RS | LCD_TRACE_E
+};
+
+// Bus trace recorder for LiquidCrystal::trace() in a build with
+// LCD_TRACE. decode() turns the frames back into the bytes the
+// controller received: it latches the data lines on each falling E
+// and follows function sets between 8 and 4-bit mode like the
+// controller does, so attach it before begin().
+class LiquidCrystalTrace {
+public:
+  LiquidCrystalTrace(LCDTraceFrame *frames, uint16_t size);
+
+  void record(uint16_t lines);
+  uint16_t count();          // frames recorded since the last decode()
+  bool overflowed();         // frames were dropped, buffer was full
+  const LCDTraceFrame &frame(uint16_t);
+  uint16_t decode(uint16_t *bytes, uint16_t max); // value | LCD_TRACE_RS
+private:
+  LCDTraceFrame *_frames;
+  uint16_t _size;
+  uint16_t _count;
+  bool     _overflowed;
+  bool     _eightBit;       // controller interface width
+  bool     _highNibble;     // 4-bit mode, the high nibble is in _nibble
+  uint8_t  _nibble;
+  bool     _enable;         // E in the last frame
 };
 
 #endif
\ No newline at end of file
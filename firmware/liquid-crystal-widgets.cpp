@@ -0,0 +1,226 @@
+/*
+ * BAR GRAPH, BIG NUMBER AND MARQUEE WIDGETS
+ * 74HC595 LIBRARY FOR SPARK CORE
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include <string.h>
+
+#include "liquid-crystal-widgets.h"
+
+/* ========= Glyphs ====================== */
+
+// columns per DDRAM row in 2-line mode, and the display shift's period
+#define LCD_DDRAM_COLS 40
+
+// ROM characters (A00 and A02 both have them)
+#define LCD_CHAR_BLANK ' '
+#define LCD_CHAR_BLOCK 0xFF
+
+// Big numeral segments: LT UB RT LL LB LR UMB LMB
+static const uint8_t BIG_SEGMENTS[8][8] = {
+  { 0x07, 0x0F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F }, // left top
+  { 0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00 }, // upper bar
+  { 0x1C, 0x1E, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F }, // right top
+  { 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x0F, 0x07 }, // left bottom
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F }, // lower bar
+  { 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1E, 0x1C }, // right bottom
+  { 0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x1F, 0x1F }, // upper middle bars
+  { 0x1F, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F }, // lower middle bars
+};
+
+#define BIG_BLOCK 8
+#define BIG_BLANK 9
+
+// top row left to right, then the bottom row, for '0'-'9' and a blank
+static const uint8_t BIG_DIGITS[11][6] = {
+  { 0, 1, 2,  3, 4, 5 },
+  { 1, 2, BIG_BLANK,  4, BIG_BLOCK, 4 },
+  { 6, 6, 2,  3, 7, 7 },
+  { 6, 6, 2,  7, 7, 5 },
+  { 3, 4, BIG_BLOCK,  BIG_BLANK, BIG_BLANK, BIG_BLOCK },
+  { BIG_BLOCK, 6, 6,  7, 7, 5 },
+  { 0, 6, 6,  3, 7, 5 },
+  { 1, 1, 2,  BIG_BLANK, BIG_BLANK, BIG_BLOCK },
+  { 0, 6, 2,  3, 7, 5 },
+  { 0, 6, 2,  7, 7, 5 },
+  { BIG_BLANK, BIG_BLANK, BIG_BLANK,  BIG_BLANK, BIG_BLANK, BIG_BLANK },
+};
+
+// Write the cells of one row that differ from what was last written.
+// setCursor() only costs a command when the address has to jump, the
+// controller state tracking drops it between neighboring cells.
+static void updateRow(LiquidCrystal &lcd, uint8_t col, uint8_t row,
+                      const uint8_t *cells, uint8_t *shown, uint8_t width, bool all)
+{
+  for (uint8_t i = 0; i < width; i++) {
+    if (all || cells[i] != shown[i]) {
+      lcd.setCursor(col + i, row);
+      lcd.write(cells[i]);
+      shown[i] = cells[i];
+    }
+  }
+}
+
+/* ========= LcdBarGraph ================= */
+
+LcdBarGraph::LcdBarGraph(LiquidCrystal &lcd, uint8_t col, uint8_t row, uint8_t width)
+  : _lcd(lcd), _col(col), _row(row), _drawn(false)
+{
+  _width = width < LCD_MAX_COLS ? width : LCD_MAX_COLS;
+}
+
+void LcdBarGraph::draw(uint32_t value, uint32_t max)
+{
+  uint32_t steps = _width * 5;
+  uint32_t filled = 0;
+  if (max) {
+    filled = value >= max ? steps : (uint32_t)((uint64_t)value * steps / max);
+  }
+
+  // full blocks, one partial cell, then blanks
+  uint8_t cells[LCD_MAX_COLS];
+  for (uint8_t i = 0; i < _width; i++) {
+    uint8_t level = filled >= 5 ? 5 : filled;
+    filled -= level;
+    if (level == 5) {
+      cells[i] = LCD_CHAR_BLOCK;
+    }
+    else if (level == 0) {
+      cells[i] = LCD_CHAR_BLANK;
+    }
+    else {
+      uint8_t bitmap[8];
+      memset(bitmap, 0x1F & ~(0x1F >> level), sizeof(bitmap)); // left columns lit
+      cells[i] = _lcd.glyph(LCD_GLYPH_BAR + level, bitmap);
+    }
+  }
+  updateRow(_lcd, _col, _row, cells, _cells, _width, !_drawn);
+  _drawn = true;
+}
+
+void LcdBarGraph::redraw()
+{
+  _drawn = false;
+}
+
+/* ========= LcdBigNumber ================ */
+
+LcdBigNumber::LcdBigNumber(LiquidCrystal &lcd, uint8_t col, uint8_t row, uint8_t digits)
+  : _lcd(lcd), _col(col), _row(row), _drawn(false)
+{
+  if (digits > (LCD_MAX_COLS + 1) / 4) {
+    digits = (LCD_MAX_COLS + 1) / 4;
+  }
+  else if (digits == 0) {
+    digits = 1;
+  }
+  _width = digits * 4 - 1;
+}
+
+void LcdBigNumber::draw(uint32_t value)
+{
+  uint8_t cells[2][LCD_MAX_COLS];
+  uint8_t codes[8];  // segment -> character code, looked up on first use
+  uint8_t looked = 0;
+
+  // right to left, blanks once the value runs out
+  for (int8_t pos = _width - 3; pos >= 0; pos -= 4) {
+    uint8_t digit = (value || pos == _width - 3) ? value % 10 : 10;
+    value /= 10;
+    for (uint8_t i = 0; i < 6; i++) {
+      uint8_t segment = BIG_DIGITS[digit][i];
+      uint8_t code;
+      if (segment == BIG_BLOCK) {
+        code = LCD_CHAR_BLOCK;
+      }
+      else if (segment == BIG_BLANK) {
+        code = LCD_CHAR_BLANK;
+      }
+      else {
+        if (!(looked & (1 << segment))) {
+          codes[segment] = _lcd.glyph(LCD_GLYPH_BIG + segment, BIG_SEGMENTS[segment]);
+          looked |= 1 << segment;
+        }
+        code = codes[segment];
+      }
+      cells[i / 3][pos + i % 3] = code;
+    }
+    if (pos >= 1) {
+      cells[0][pos - 1] = LCD_CHAR_BLANK;  // gap
+      cells[1][pos - 1] = LCD_CHAR_BLANK;
+    }
+  }
+  updateRow(_lcd, _col, _row, cells[0], _cells[0], _width, !_drawn);
+  updateRow(_lcd, _col, _row + 1, cells[1], _cells[1], _width, !_drawn);
+  _drawn = true;
+}
+
+void LcdBigNumber::redraw()
+{
+  _drawn = false;
+}
+
+/* ========= LcdMarquee ================== */
+
+LcdMarquee::LcdMarquee(LiquidCrystal &lcd, uint8_t row, uint8_t width)
+  : _lcd(lcd), _text(""), _textLength(0), _period(LCD_DDRAM_COLS), _row(row),
+    _shift(0), _pos(0), _ahead(0)
+{
+  _width = width < LCD_DDRAM_COLS ? width : LCD_DDRAM_COLS;
+}
+
+void LcdMarquee::begin(const char *text, uint8_t gap)
+{
+  _text = text;
+  _textLength = strlen(text);
+  _period = _textLength + gap;
+  if (_period < LCD_DDRAM_COLS) {
+    _period = LCD_DDRAM_COLS;  // wraps with the DDRAM row, never rewritten
+  }
+  _lcd.home();  // undo any display shift
+  _shift = 0;
+  _pos = 0;
+  fill(0, 0, LCD_DDRAM_COLS);
+  _ahead = LCD_DDRAM_COLS - _width;
+}
+
+void LcdMarquee::step()
+{
+  if (_ahead == 0 && _period != LCD_DDRAM_COLS) {
+    // every column out of view is behind the text now, refill them
+    _ahead = LCD_DDRAM_COLS - _width;
+    fill((_shift + _width) % LCD_DDRAM_COLS, _pos + _width, _ahead);
+  }
+  _lcd.scrollDisplayLeft();
+  _shift = (_shift + 1) % LCD_DDRAM_COLS;
+  _pos = (_pos + 1) % _period;
+  if (_ahead) {
+    _ahead--;
+  }
+}
+
+char LcdMarquee::charAt(uint16_t pos)
+{
+  pos %= _period;
+  return pos < _textLength ? _text[pos] : ' ';
+}
+
+// Write count characters from text position pos into DDRAM columns
+// from col, wrapping at the end of the row. The address counter runs
+// on into the next row there, so that takes a second setCursor().
+void LcdMarquee::fill(uint8_t col, uint16_t pos, uint8_t count)
+{
+  _lcd.setCursor(col, _row);
+  for (uint8_t i = 0; i < count; i++) {
+    if (col == LCD_DDRAM_COLS) {
+      col = 0;
+      _lcd.setCursor(0, _row);
+    }
+    _lcd.write(charAt(pos + i));
+    col++;
+  }
+}
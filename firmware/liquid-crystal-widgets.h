@@ -0,0 +1,101 @@
+#ifndef LiquidCrystalWidgets_h
+#define LiquidCrystalWidgets_h
+
+/*
+ * BAR GRAPH, BIG NUMBER AND MARQUEE WIDGETS
+ * 74HC595 LIBRARY FOR SPARK CORE
+ * =======================================================
+ * Dashboard widgets drawn with custom characters. The glyphs
+ * come from LiquidCrystal's glyph cache, so they are uploaded
+ * once, and draw() only rewrites the cells that changed:
+ *
+ *   LcdBarGraph bar(lcd, 0, 1, 16);    // col 0, row 1, 16 cells
+ *   LcdBigNumber big(lcd, 0, 0, 4);    // 4 digits on rows 0-1
+ *
+ *   bar.draw(analogRead(A0), 4095);
+ *   big.draw(millis() / 1000);
+ *
+ * A bar graph needs 4 CGRAM slots and a big number 8, so only
+ * one kind fits on the screen at a time.
+ *
+ * LcdMarquee scrolls text longer than the screen with the
+ * controller's display shift, one command per step:
+ *
+ *   LcdMarquee news(lcd, 0, 16);       // row 0 of a 16 column display
+ *   news.begin("Breaking: 74HC595 still in production");
+ *   news.step();                       // every 300ms or so
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include "liquid-crystal-spi.h"
+
+/* ========= Widgets ===================== */
+
+// glyph() ids the widgets use, keep application ids below these
+#define LCD_GLYPH_BAR 0xFF00 // + 1-4 columns filled
+#define LCD_GLYPH_BIG 0xFF10 // + segment 0-7
+
+// Horizontal bar, 5 steps per cell
+class LcdBarGraph {
+public:
+  LcdBarGraph(LiquidCrystal &lcd, uint8_t col, uint8_t row, uint8_t width);
+
+  void draw(uint32_t value, uint32_t max);
+  void redraw();  // the glass was cleared, draw everything next time
+private:
+  LiquidCrystal &_lcd;
+  uint8_t _col;
+  uint8_t _row;
+  uint8_t _width;
+  bool    _drawn;               // _cells is what the glass shows
+  uint8_t _cells[LCD_MAX_COLS]; // character codes last written
+};
+
+// 3x2 cell numerals, one blank column between digits
+class LcdBigNumber {
+public:
+  LcdBigNumber(LiquidCrystal &lcd, uint8_t col, uint8_t row, uint8_t digits);
+
+  void draw(uint32_t value);  // right aligned, no leading zeros
+  void redraw();
+private:
+  LiquidCrystal &_lcd;
+  uint8_t _col;
+  uint8_t _row;
+  uint8_t _width;
+  bool    _drawn;
+  uint8_t _cells[2][LCD_MAX_COLS];
+};
+
+// Text scrolling right to left on a display begun with 2 lines (not
+// 4: rows 2 and 3 are the far end of rows 0 and 1). Each DDRAM row is
+// 40 columns and scrollDisplayLeft() moves the view over them, so
+// the text is written once and a step is a single command. Text longer
+// than 40 - gap is rewritten in the columns out of view, in one burst
+// each time the view has moved past all of them. The controller shifts
+// every row together: whatever is on the other row scrolls along.
+class LcdMarquee {
+public:
+  LcdMarquee(LiquidCrystal &lcd, uint8_t row, uint8_t width);
+
+  void begin(const char *text, uint8_t gap = 4);  // text isn't copied
+  void step();    // move the text one column left
+private:
+  char charAt(uint16_t pos);
+  void fill(uint8_t col, uint16_t pos, uint8_t count);
+
+  LiquidCrystal &_lcd;
+  const char *_text;
+  uint16_t _textLength;
+  uint16_t _period;   // text + gap, at least a whole DDRAM row
+  uint8_t _row;
+  uint8_t _width;
+  uint8_t _shift;     // DDRAM column at the left edge of the screen
+  uint16_t _pos;      // text position at the left edge of the screen
+  uint8_t _ahead;     // columns right of the screen holding the right text
+};
+
+#endif
@@ -0,0 +1,343 @@
+/*
+ * HOST (LINUX) STAND-IN FOR THE SPARK CORE WIRING LIBRARY
+ * =======================================================
+ * Routes the wiring calls used by liquid-crystal-spi.cpp into
+ * the simulated board and charges each one its approximate
+ * cost on a 72MHz Core.
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include <math.h>
+
+#include "application.h"
+#include "lcd-sim.h"
+
+using sim::board;
+
+/* ========= GPIO ======================== */
+
+enum { REG_CRL, REG_CRH, REG_IDR, REG_ODR, REG_BSRR, REG_BRR };
+
+GPIO_TypeDef::GPIO_TypeDef(uint8_t port)
+{
+  CRL.port = CRH.port = IDR.port = ODR.port = BSRR.port = BRR.port = port;
+  CRL.kind = REG_CRL;
+  CRH.kind = REG_CRH;
+  IDR.kind = REG_IDR;
+  ODR.kind = REG_ODR;
+  BSRR.kind = REG_BSRR;
+  BRR.kind = REG_BRR;
+}
+
+GPIO_Reg &GPIO_Reg::operator=(uint32_t value)
+{
+  board.cycles(sim::CYCLES_REG_STORE);
+  switch (kind) {
+    case REG_CRL:  board.portConfigure(port, 0, value); break;
+    case REG_CRH:  board.portConfigure(port, 8, value); break;
+    case REG_ODR:  board.portWrite(port, value & 0xFFFF, ~value & 0xFFFF); break;
+    case REG_BSRR: board.portWrite(port, value & 0xFFFF, value >> 16); break;
+    case REG_BRR:  board.portWrite(port, 0, value & 0xFFFF); break;
+    default: break;
+  }
+  return *this;
+}
+
+GPIO_Reg::operator uint32_t() const
+{
+  board.cycles(sim::CYCLES_REG_STORE);
+  if (kind == REG_CRL || kind == REG_CRH) {
+    return board.portConfiguration(port, kind == REG_CRH ? 8 : 0);
+  }
+  return board.portRead(port);
+}
+
+GPIO_TypeDef GPIOA_Port(0);
+GPIO_TypeDef GPIOB_Port(1);
+
+static STM32_Pin_Info pinInfo[TOTAL_PINS];
+
+const STM32_Pin_Info &STM32_Pin_Map::operator[](uint16_t pin) const
+{
+  board.cycles(sim::CYCLES_PIN_MAP_LOAD);
+  const sim::PinPort &pp = sim::PIN_PORTS[pin];
+  pinInfo[pin].gpio_peripheral = pp.port == 0 ? GPIOA : pp.port == 1 ? GPIOB : 0;
+  pinInfo[pin].gpio_pin = 1 << pp.bit;
+  return pinInfo[pin];
+}
+
+const STM32_Pin_Map PIN_MAP = STM32_Pin_Map();
+
+/* ========= Wiring ====================== */
+
+void pinMode(uint16_t pin, PinMode setMode)
+{
+  board.cycles(sim::CYCLES_PIN_MODE);
+  board.pinMode(pin, setMode == OUTPUT ? 0 : 1);
+}
+
+void digitalWrite(uint16_t pin, uint8_t value)
+{
+  board.cycles(sim::CYCLES_DIGITAL_WRITE);
+  board.counters.digitalWrites++;
+  board.pinWrite(pin, value);
+}
+
+int32_t digitalRead(uint16_t pin)
+{
+  board.cycles(sim::CYCLES_DIGITAL_READ);
+  return board.pinRead(pin);
+}
+
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val)
+{
+  for (uint8_t i = 0; i < 8; i++) {
+    if (bitOrder == LSBFIRST) {
+      digitalWrite(dataPin, !!(val & (1 << i)));
+    }
+    else {
+      digitalWrite(dataPin, !!(val & (1 << (7 - i))));
+    }
+    digitalWrite(clockPin, HIGH);
+    digitalWrite(clockPin, LOW);
+  }
+}
+
+void delay(unsigned long ms)
+{
+  board.advanceNs((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  board.counters.delayUs += us;
+  board.advanceNs((uint64_t)us * 1000);
+}
+
+unsigned long millis(void)
+{
+  board.cycles(sim::CYCLES_TIME_READ);
+  return board.nowUs() / 1000;
+}
+
+unsigned long micros(void)
+{
+  board.cycles(sim::CYCLES_TIME_READ);
+  return board.nowUs();
+}
+
+void lcdHostNop4(void)
+{
+  board.cycles(sim::CYCLES_NOP4);
+}
+
+uint32_t lcdHostCycles(void)
+{
+  board.cycles(sim::CYCLES_REG_STORE);
+  return (uint32_t)(board.nowPs() * 9 / 125000);
+}
+
+/* ========= SPI ========================= */
+
+SPIClass SPI;
+
+void SPIClass::begin()
+{
+  enabled = true;
+  bitOrder = MSBFIRST;
+  dataMode = SPI_MODE0;
+  clockDivider = SPI_CLOCK_DIV256;
+}
+
+void SPIClass::end()
+{
+  enabled = false;
+}
+
+void SPIClass::setBitOrder(uint8_t order)
+{
+  bitOrder = order;
+}
+
+void SPIClass::setDataMode(uint8_t mode)
+{
+  dataMode = mode;
+}
+
+void SPIClass::setClockDivider(uint8_t divider)
+{
+  clockDivider = divider;
+}
+
+uint8_t SPIClass::transfer(uint8_t _data)
+{
+  board.spiTransfer(_data, bitOrder == MSBFIRST, clockDivider);
+  return 0;
+}
+
+/* ========= I2C ========================= */
+
+TwoWire Wire;
+
+void TwoWire::setSpeed(uint32_t clockSpeed)
+{
+  speed = clockSpeed;
+}
+
+void TwoWire::begin()
+{
+  enabled = true;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  board.cycles(sim::CYCLES_DIGITAL_WRITE);
+  txAddress = address;
+  txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  board.cycles(sim::CYCLES_REG_STORE);
+  if (txLength >= BUFFER_LENGTH) {
+    return 0;
+  }
+  txBuffer[txLength++] = data;
+  return 1;
+}
+
+// Blocking, like the Core's: returns once STOP is on the bus
+uint8_t TwoWire::endTransmission(uint8_t sendStop)
+{
+  (void)sendStop;
+  board.cycles(sim::CYCLES_DIGITAL_WRITE);
+  return board.i2cWrite(txAddress, txBuffer, txLength, speed) ? 0 : 2;
+}
+
+/* ========= Print ======================= */
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(const char str[])
+{
+  return write(str);
+}
+
+size_t Print::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char b, int base)
+{
+  return print((unsigned long)b, base);
+}
+
+size_t Print::print(int n, int base)
+{
+  return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base)
+{
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+  if (base == 0) {
+    return write((uint8_t)n);
+  }
+  if (base == 10 && n < 0) {
+    int t = print('-');
+    return printNumber(-n, 10) + t;
+  }
+  return printNumber(n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  if (base == 0) {
+    return write((uint8_t)n);
+  }
+  return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits)
+{
+  return printFloat(n, digits);
+}
+
+size_t Print::println(void)
+{
+  return print('\r') + print('\n');
+}
+
+size_t Print::println(const char c[])
+{
+  size_t n = print(c);
+  return n + println();
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+
+  *str = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    unsigned long m = n;
+    n /= base;
+    char c = m - base * n;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+
+  return write(str);
+}
+
+size_t Print::printFloat(double number, uint8_t digits)
+{
+  size_t n = 0;
+
+  if (isnan(number)) return print("nan");
+  if (isinf(number)) return print("inf");
+
+  if (number < 0.0) {
+    n += print('-');
+    number = -number;
+  }
+
+  double rounding = 0.5;
+  for (uint8_t i = 0; i < digits; ++i) {
+    rounding /= 10.0;
+  }
+  number += rounding;
+
+  unsigned long int_part = (unsigned long)number;
+  double remainder = number - (double)int_part;
+  n += print(int_part);
+
+  if (digits > 0) {
+    n += print(".");
+  }
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    int toPrint = int(remainder);
+    n += print(toPrint);
+    remainder -= toPrint;
+  }
+  return n;
+}
@@ -0,0 +1,206 @@
+#ifndef HostApplication_h
+#define HostApplication_h
+
+/*
+ * HOST (LINUX) STAND-IN FOR THE SPARK CORE application.h
+ * =======================================================
+ * Just enough of the Spark wiring API for liquid-crystal-spi.cpp
+ * to build on a PC. Every call is routed into the 74HC595 +
+ * HD44780 behavioral model in lcd-sim.h, which runs a virtual
+ * 72MHz clock, so the library can be tested and benchmarked
+ * without a Core on the bench.
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* ========= spark_wiring.h ============== */
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+typedef enum PinMode {
+  OUTPUT,
+  INPUT,
+  INPUT_PULLUP,
+  INPUT_PULLDOWN
+} PinMode;
+
+// Spark Core pin numbering
+#define D0 0
+#define D1 1
+#define D2 2
+#define D3 3
+#define D4 4
+#define D5 5
+#define D6 6
+#define D7 7
+#define A0 10
+#define A1 11
+#define A2 12
+#define A3 13
+#define A4 14
+#define A5 15
+#define A6 16
+#define A7 17
+#define TOTAL_PINS 18
+
+#define SCK  A3
+#define MISO A4
+#define MOSI A5
+
+// GPIO registers are modelled, so writes through them reach the simulator
+struct GPIO_Reg {
+  uint8_t port;
+  uint8_t kind;
+  GPIO_Reg &operator=(uint32_t value);
+  operator uint32_t() const;
+};
+
+struct GPIO_TypeDef {
+  GPIO_Reg CRL;
+  GPIO_Reg CRH;
+  GPIO_Reg IDR;
+  GPIO_Reg ODR;
+  GPIO_Reg BSRR;
+  GPIO_Reg BRR;
+  explicit GPIO_TypeDef(uint8_t port);
+};
+
+extern GPIO_TypeDef GPIOA_Port;
+extern GPIO_TypeDef GPIOB_Port;
+#define GPIOA (&GPIOA_Port)
+#define GPIOB (&GPIOB_Port)
+
+typedef struct STM32_Pin_Info {
+  GPIO_TypeDef *gpio_peripheral;
+  uint16_t gpio_pin;
+} STM32_Pin_Info;
+
+// PIN_MAP is a flash table on the Core; indexing it costs a load
+struct STM32_Pin_Map {
+  const STM32_Pin_Info &operator[](uint16_t pin) const;
+};
+extern const STM32_Pin_Map PIN_MAP;
+
+void pinMode(uint16_t pin, PinMode setMode);
+void digitalWrite(uint16_t pin, uint8_t value);
+int32_t digitalRead(uint16_t pin);
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+unsigned long millis(void);
+unsigned long micros(void);
+
+// Software SPI settle padding (4 cycles on the Core)
+void lcdHostNop4(void);
+#define LCD_SOFTSPI_SETTLE() lcdHostNop4()
+
+// DWT cycle counter, read off the virtual clock
+uint32_t lcdHostCycles(void);
+#define LCD_CYCLE_COUNTER_START() do { } while (0)
+#define LCD_CYCLE_COUNTER() lcdHostCycles()
+#define LCD_CYCLES_PER_US 72
+
+/* ========= spark_wiring_print.h ======== */
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print
+{
+  private:
+    size_t printNumber(unsigned long, uint8_t);
+    size_t printFloat(double, uint8_t);
+
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t) = 0;
+    size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+    virtual size_t write(const uint8_t *buffer, size_t size);
+
+    size_t print(const char[]);
+    size_t print(char);
+    size_t print(unsigned char, int = DEC);
+    size_t print(int, int = DEC);
+    size_t print(unsigned int, int = DEC);
+    size_t print(long, int = DEC);
+    size_t print(unsigned long, int = DEC);
+    size_t print(double, int = 2);
+
+    size_t println(void);
+    size_t println(const char[]);
+};
+
+/* ========= spark_wiring_spi.h ========== */
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x01
+#define SPI_MODE2 0x02
+#define SPI_MODE3 0x03
+
+#define SPI_CLOCK_DIV2   0x00
+#define SPI_CLOCK_DIV4   0x08
+#define SPI_CLOCK_DIV8   0x10
+#define SPI_CLOCK_DIV16  0x18
+#define SPI_CLOCK_DIV32  0x20
+#define SPI_CLOCK_DIV64  0x28
+#define SPI_CLOCK_DIV128 0x30
+#define SPI_CLOCK_DIV256 0x38
+
+class SPIClass {
+  public:
+    void begin();
+    void end();
+    void setBitOrder(uint8_t);
+    void setDataMode(uint8_t);
+    void setClockDivider(uint8_t);
+    uint8_t transfer(uint8_t _data);
+
+    uint8_t bitOrder;
+    uint8_t dataMode;
+    uint8_t clockDivider;
+    bool enabled;
+};
+
+extern SPIClass SPI;
+
+/* ========= spark_wiring_i2c.h ========== */
+
+#define BUFFER_LENGTH 32
+
+#define CLOCK_SPEED_100KHZ 100000
+#define CLOCK_SPEED_400KHZ 400000
+
+class TwoWire {
+  public:
+    TwoWire() : speed(CLOCK_SPEED_100KHZ), enabled(false), txAddress(0), txLength(0) {}
+    void setSpeed(uint32_t);
+    void begin();
+    void beginTransmission(uint8_t);
+    uint8_t endTransmission(uint8_t = true);
+    size_t write(uint8_t);
+
+    uint32_t speed;
+    bool enabled;
+
+  private:
+    uint8_t txAddress;
+    uint8_t txBuffer[BUFFER_LENGTH];
+    uint8_t txLength;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,467 @@
+/*
+ * HOST BUS-TRANSACTION AND TIMING BENCHMARK
+ * =======================================================
+ * Runs every public LiquidCrystal call on each transport
+ * against the simulated board and reports what it cost on the
+ * bus: 595 latches (one per spiSendOut()), bytes shifted, GPIO
+ * calls, E strobes, time spent in delayMicroseconds() and total
+ * virtual time on a 72MHz Core.
+ *
+ *   bench-lcd                  print the table
+ *   bench-lcd --check FILE     also fail if anything got slower
+ *   bench-lcd --write FILE     record a new baseline
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "lcd-rig.h"
+
+using sim::board;
+
+/* ========= Measurement ================= */
+
+struct Result {
+  std::string transport;
+  std::string op;
+  uint32_t latches;
+  uint32_t bytes;
+  uint32_t gpio;     // digitalWrite() + pinMode() calls
+  uint32_t strobes;
+  uint64_t delayUs;
+  uint64_t totalNs;
+};
+
+static std::vector<Result> results;
+
+class Meter {
+public:
+  Meter(Transport t, const char *op) : _t(t), _op(op)
+  {
+    _c = board.counters;
+    _ns = board.nowNs();
+  }
+  ~Meter()
+  {
+    const sim::Counters &c = board.counters;
+    Result r;
+    r.transport = TRANSPORT_NAMES[_t];
+    r.op = _op;
+    r.latches = c.latches - _c.latches;
+    r.bytes = (c.bitsShifted - _c.bitsShifted) / 8;
+    r.gpio = (c.digitalWrites - _c.digitalWrites) + (c.pinModes - _c.pinModes);
+    r.strobes = c.strobes - _c.strobes;
+    r.delayUs = c.delayUs - _c.delayUs;
+    r.totalNs = board.nowNs() - _ns;
+    results.push_back(r);
+  }
+
+private:
+  Transport _t;
+  const char *_op;
+  sim::Counters _c;
+  uint64_t _ns;
+};
+
+static const char LINE16[] = "0123456789ABCDEF";
+static const char LINE20[] = "0123456789ABCDEFGHIJ";
+
+static void redraw(LiquidCrystal *lcd, uint8_t rows, const char *line)
+{
+  for (uint8_t r = 0; r < rows; r++) {
+    lcd->setCursor(0, r);
+    lcd->print(line);
+  }
+}
+
+// one line as single write(uint8_t) calls, to compare with print()
+static void putLine(LiquidCrystal *lcd, const char *line)
+{
+  lcd->setCursor(0, 0);
+  while (*line) {
+    lcd->write((uint8_t)*line++);
+  }
+}
+
+static void printLine(LiquidCrystal *lcd, const char *line)
+{
+  lcd->setCursor(0, 0);
+  lcd->print(line);
+}
+
+// a status line with 4 icons, redrawn the way icon-heavy UIs do it
+static const uint8_t ICONS[4][8] = {
+  { 0x04, 0x0E, 0x1F, 0x04, 0x04, 0x04, 0x04, 0x00 },
+  { 0x00, 0x0A, 0x1F, 0x1F, 0x0E, 0x04, 0x00, 0x00 },
+  { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x1B, 0x1F, 0x00 },
+  { 0x01, 0x03, 0x05, 0x09, 0x09, 0x0B, 0x1B, 0x18 },
+};
+
+static void iconsUploaded(LiquidCrystal *lcd)
+{
+  for (uint8_t i = 0; i < 4; i++) {
+    lcd->createChar(i, ICONS[i]);
+  }
+  lcd->setCursor(0, 0);
+  for (uint8_t i = 0; i < 4; i++) {
+    lcd->write(i);
+  }
+}
+
+static void iconsCached(LiquidCrystal *lcd)
+{
+  lcd->setCursor(0, 0);
+  for (uint8_t i = 0; i < 4; i++) {
+    lcd->writeGlyph(i, ICONS[i]);
+  }
+}
+
+// The widgets' output done the naive way: reload the glyphs and
+// rewrite the whole widget on every update
+static void naiveBar(LiquidCrystal *lcd, uint32_t value, uint32_t max)
+{
+  uint8_t bitmap[8];
+  for (uint8_t level = 1; level < 5; level++) {
+    memset(bitmap, 0x1F & ~(0x1F >> level), sizeof(bitmap));
+    lcd->createChar(level - 1, bitmap);
+  }
+  uint32_t filled = value * 80 / max;
+  lcd->setCursor(0, 1);
+  for (uint8_t i = 0; i < 16; i++) {
+    uint8_t level = filled >= 5 ? 5 : filled;
+    filled -= level;
+    lcd->write(level == 5 ? 0xFF : level == 0 ? ' ' : level - 1);
+  }
+}
+
+static void naiveBig(LiquidCrystal *lcd, uint32_t value)
+{
+  uint8_t bitmap[8] = { 0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x1F, 0x1F };
+  for (uint8_t i = 0; i < 8; i++) {
+    lcd->createChar(i, bitmap);
+  }
+  for (uint8_t row = 0; row < 2; row++) {
+    lcd->setCursor(0, row);
+    for (uint8_t i = 0; i < 15; i++) {
+      lcd->write((value + i) & 0x07);
+    }
+  }
+}
+
+// Marquee done by reprinting the visible line at each step
+static void naiveMarquee(LiquidCrystal *lcd, const char *text, uint16_t period, uint16_t pos)
+{
+  uint16_t length = strlen(text);
+  lcd->setCursor(0, 0);
+  for (uint8_t c = 0; c < 16; c++) {
+    uint16_t p = (pos + c) % period;
+    lcd->write(p < length ? text[p] : ' ');
+  }
+}
+
+// Fixed point reading the usual way: position, then print it padded
+static void naiveField(LiquidCrystal *lcd, int32_t centi)
+{
+  char text[8];
+  snprintf(text, sizeof(text), "%4ld.%02ld", (long)(centi / 100), (long)(centi % 100));
+  lcd->setCursor(6, 0);
+  lcd->print(text);
+}
+
+static void bench(Transport t)
+{
+  uint8_t glyph[8] = { 0x04, 0x0E, 0x1F, 0x04, 0x04, 0x04, 0x04, 0x00 };
+  LiquidCrystal *lcd = rigLcd(t);
+
+  { Meter m(t, "begin");        lcd->begin(16, 2); }
+  { Meter m(t, "write");        lcd->write('A'); }
+  { Meter m(t, "print-14");     lcd->print("Hello, Sparky!"); }
+  { Meter m(t, "setCursor");    lcd->setCursor(0, 1); }
+  { Meter m(t, "clear");        lcd->clear(); }
+  { Meter m(t, "home");         lcd->home(); }
+  { Meter m(t, "display");      lcd->display(); }
+  { Meter m(t, "createChar");   lcd->createChar(0, glyph); }
+  { Meter m(t, "redraw-16x2");  redraw(lcd, 2, LINE16); }
+  // both from row 1, so neither setCursor(0, 0) is skipped as redundant
+  lcd->setCursor(0, 1);
+  { Meter m(t, "putc-16");      putLine(lcd, LINE16); }
+  lcd->setCursor(0, 1);
+  { Meter m(t, "line-16");      printLine(lcd, LINE16); }
+
+  lcd->async();
+  { Meter m(t, "async-print-14"); lcd->print("Hello, Sparky!"); }
+  lcd->noAsync();
+
+  lcd->framebuffer();
+  redraw(lcd, 2, LINE16);
+  lcd->flush();
+  { Meter m(t, "fb-same-16x2"); redraw(lcd, 2, LINE16); lcd->flush(); }
+  { Meter m(t, "fb-1cell-16x2"); redraw(lcd, 2, LINE16); lcd->setCursor(7, 1); lcd->write('*'); lcd->flush(); }
+  delete lcd;
+
+  lcd = rigLcd(t);
+  lcd->async();
+  { Meter m(t, "async-begin");  lcd->begin(16, 2); }
+  delete lcd;
+
+  lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  iconsUploaded(lcd);
+  { Meter m(t, "icons-upload"); iconsUploaded(lcd); }
+  iconsCached(lcd);
+  { Meter m(t, "icons-cached"); iconsCached(lcd); }
+  delete lcd;
+
+  // 10 updates of a 16 cell bar and a 4 digit big number
+  lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  { Meter m(t, "bar-naive-10");
+    for (uint32_t v = 40; v < 50; v++) {
+      naiveBar(lcd, v, 100);
+    }
+  }
+  lcd->clear();
+  LcdBarGraph bar(*lcd, 0, 1, 16);
+  bar.draw(39, 100);
+  { Meter m(t, "bar-update-10");
+    for (uint32_t v = 40; v < 50; v++) {
+      bar.draw(v, 100);
+    }
+  }
+  lcd->clear();
+  { Meter m(t, "big-naive-10");
+    for (uint32_t v = 1230; v < 1240; v++) {
+      naiveBig(lcd, v);
+    }
+  }
+  lcd->clear();
+  LcdBigNumber big(*lcd, 0, 0, 4);
+  big.draw(1229);
+  { Meter m(t, "big-update-10");
+    for (uint32_t v = 1230; v < 1240; v++) {
+      big.draw(v);
+    }
+  }
+  delete lcd;
+
+  // 48 steps of a 56 character marquee, one full refill included
+  const char *news = "The quick brown fox jumps over the lazy dog, twice over.";
+  lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  { Meter m(t, "marquee-naive");
+    for (uint16_t pos = 1; pos <= 48; pos++) {
+      naiveMarquee(lcd, news, 60, pos);
+    }
+  }
+  lcd->clear();
+  LcdMarquee marquee(*lcd, 0, 16);
+  marquee.begin(news);
+  { Meter m(t, "marquee-shift");
+    for (uint16_t pos = 1; pos <= 48; pos++) {
+      marquee.step();
+    }
+  }
+  delete lcd;
+
+  // 10 readings of a 7 cell fixed point field
+  lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  { Meter m(t, "field-print");
+    for (int32_t v = 2150; v < 2160; v++) {
+      naiveField(lcd, v);
+    }
+  }
+  lcd->printNumber(6, 0, 7, 2149, 2);
+  { Meter m(t, "field-update");
+    for (int32_t v = 2150; v < 2160; v++) {
+      lcd->printNumber(6, 0, 7, v, 2);
+    }
+  }
+  delete lcd;
+
+  // 100 readings 1ms apart, printed as they come versus through a 10Hz
+  // region (the idle time between readings counts in both)
+  lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  { Meter m(t, "sched-every");
+    for (int32_t v = 2000; v < 2100; v++) {
+      lcd->printNumber(6, 0, 7, v, 2);
+      board.advanceNs(1000000);
+    }
+  }
+  LcdScheduler screen(*lcd, 2000);
+  int8_t reading = screen.region(6, 0, 7, 1, 10);
+  { Meter m(t, "sched-10hz");
+    for (int32_t v = 2100; v < 2200; v++) {
+      screen.setNumber(reading, v, 2);
+      screen.tick();
+      board.advanceNs(1000000);
+    }
+  }
+  delete lcd;
+
+  lcd = rigLcd(t);
+  board.lcd.setGeometry(20, 4);
+  lcd->begin(20, 4);
+  { Meter m(t, "redraw-20x4");  redraw(lcd, 4, LINE20); }
+  lcd->setCursor(0, 1);
+  { Meter m(t, "putc-20");      putLine(lcd, LINE20); }
+  lcd->setCursor(0, 1);
+  { Meter m(t, "line-20");      printLine(lcd, LINE20); }
+  delete lcd;
+}
+
+// the same 16x2 redraw on n displays sharing one bus
+static void benchBus(Transport t, uint8_t n, const char *op)
+{
+  static const uint8_t latches[] = { A1, A0 };
+  LiquidCrystal *lcds[3];
+  LiquidCrystalBus bus;
+
+  lcds[0] = rigLcd(t);
+  for (uint8_t i = 1; i < n; i++) {
+    lcds[i] = rigAnotherLcd(t, latches[i - 1]);
+  }
+  for (uint8_t i = 0; i < n; i++) {
+    bus.attach(*lcds[i]);
+    lcds[i]->begin(16, 2);
+  }
+  bus.flushBlocking();
+  { Meter m(t, op);
+    for (uint8_t i = 0; i < n; i++) {
+      redraw(lcds[i], 2, LINE16);
+    }
+    bus.flushBlocking();
+  }
+  for (uint8_t i = 0; i < n; i++) {
+    delete lcds[i];
+  }
+}
+
+template <class Lcd>
+static void benchTemplate(Transport t)
+{
+  rigBoard(t);
+  Lcd lcd;
+
+  { Meter m(t, "T-begin");       lcd.begin(16, 2); }
+  { Meter m(t, "T-write");       lcd.write('A'); }
+  { Meter m(t, "T-print-14");    lcd.print("Hello, Sparky!"); }
+  { Meter m(t, "T-redraw-16x2");
+    for (uint8_t r = 0; r < 2; r++) {
+      lcd.setCursor(0, r);
+      lcd.print(LINE16);
+    }
+  }
+}
+
+/* ========= Baselines =================== */
+
+static bool writeBaseline(const char *path)
+{
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  fprintf(f, "# transport op latches bytes gpio strobes delay_us total_ns\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    fprintf(f, "%s %s %u %u %u %u %llu %llu\n", r.transport.c_str(), r.op.c_str(),
+            r.latches, r.bytes, r.gpio, r.strobes,
+            (unsigned long long)r.delayUs, (unsigned long long)r.totalNs);
+  }
+  fclose(f);
+  return true;
+}
+
+// Every metric must be at or below the baseline, total time within 1%.
+// Rows on only one side fail too, so a renamed or dropped op can't pass.
+static bool checkBaseline(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  bool ok = true;
+  std::vector<bool> matched(results.size(), false);
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    char transport[32], op[64];
+    unsigned latches, bytes, gpio, strobes;
+    unsigned long long delayUs, totalNs;
+    if (line[0] == '#' || sscanf(line, "%31s %63s %u %u %u %u %llu %llu", transport, op,
+                                 &latches, &bytes, &gpio, &strobes, &delayUs, &totalNs) != 8) {
+      continue;
+    }
+    bool found = false;
+    for (size_t i = 0; i < results.size(); i++) {
+      const Result &r = results[i];
+      if (r.transport != transport || r.op != op) {
+        continue;
+      }
+      found = true;
+      matched[i] = true;
+      if (r.latches > latches || r.bytes > bytes || r.gpio > gpio ||
+          r.strobes > strobes || r.delayUs > delayUs || r.totalNs * 100 > totalNs * 101) {
+        printf("REGRESSION %s %s: %u/%u/%u/%u %lluus %lluns, baseline %u/%u/%u/%u %lluus %lluns\n",
+               transport, op, r.latches, r.bytes, r.gpio, r.strobes,
+               (unsigned long long)r.delayUs, (unsigned long long)r.totalNs,
+               latches, bytes, gpio, strobes, delayUs, totalNs);
+        ok = false;
+      }
+    }
+    if (!found) {
+      printf("MISSING %s %s: in the baseline but not measured\n", transport, op);
+      ok = false;
+    }
+  }
+  fclose(f);
+  for (size_t i = 0; i < results.size(); i++) {
+    if (!matched[i]) {
+      printf("UNMATCHED %s %s: measured but not in the baseline\n",
+             results[i].transport.c_str(), results[i].op.c_str());
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+/* ========= Main ======================== */
+
+int main(int argc, char **argv)
+{
+  for (int t = 0; t < TRANSPORT_COUNT; t++) {
+    bench((Transport)t);
+  }
+  benchBus(HARDWARE_SPI, 1, "bus-1x-16x2");
+  benchBus(HARDWARE_SPI, 3, "bus-3x-16x2");
+  benchBus(SOFTWARE_SPI, 1, "bus-1x-16x2");
+  benchBus(SOFTWARE_SPI, 3, "bus-3x-16x2");
+  benchTemplate<HardwareSpiLcdT>(HARDWARE_SPI);
+  benchTemplate<SoftwareSpiLcdT>(SOFTWARE_SPI);
+
+  printf("%-9s %-14s %8s %8s %8s %8s %10s %11s\n",
+         "transport", "op", "latches", "bytes", "gpio", "strobes", "delay_us", "total_us");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    printf("%-9s %-14s %8u %8u %8u %8u %10llu %11.1f\n", r.transport.c_str(), r.op.c_str(),
+           r.latches, r.bytes, r.gpio, r.strobes,
+           (unsigned long long)r.delayUs, r.totalNs / 1000.0);
+  }
+
+  if (argc == 3 && !strcmp(argv[1], "--write")) {
+    return writeBaseline(argv[2]) ? 0 : 1;
+  }
+  if (argc == 3 && !strcmp(argv[1], "--check")) {
+    return checkBaseline(argv[2]) ? 0 : 1;
+  }
+  return 0;
+}
@@ -0,0 +1,164 @@
+#ifndef LcdRig_h
+#define LcdRig_h
+
+/*
+ * BENCH RIGS FOR THE HOST SIMULATION
+ * =======================================================
+ * Wires the simulated board the same way the examples and
+ * the README wire a real Core, and hands back a LiquidCrystal
+ * that is ready for begin().
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include "application.h"
+#include "lcd-sim.h"
+#include "liquid-crystal-spi.h"
+#include "liquid-crystal-spi-t.h"
+#include "liquid-crystal-widgets.h"
+#include "liquid-crystal-scheduler.h"
+
+/* ========= Rigs ======================== */
+
+enum Transport {
+  HARDWARE_SPI,  // LiquidCrystal lcd(A2);
+  SOFTWARE_SPI,  // LiquidCrystal lcd(D2, D3, D4);
+  CASCADE_SPI,   // LiquidCrystal lcd(A2); lcd.initSPI16();
+  I2C_BACKPACK,  // LiquidCrystal lcd(0); lcd.initI2C();
+  PARALLEL_4BIT, // LiquidCrystal lcd(D0, D1, D4, D5, D6, D7);
+  PARALLEL_RW,   // LiquidCrystal lcd(D0, D2, D1, D4, D5, D6, D7);
+  PARALLEL_8BIT, // LiquidCrystal lcd(D0, D2, D1, D3, A0, A1, A6, D4, D5, D6, D7);
+  TRANSPORT_COUNT
+};
+
+static const char *const TRANSPORT_NAMES[TRANSPORT_COUNT] = {
+  "hw-spi", "sw-spi", "hw-spi16", "i2c", "par-4bit", "par-rw", "par-8bit"
+};
+
+// 74HC595 QA-QH as wired on the Adafruit I2C/SPI backpack
+static const sim::Signal BACKPACK_595[8] = {
+  sim::SIG_NC, sim::SIG_RS, sim::SIG_E, sim::SIG_D7,
+  sim::SIG_D6, sim::SIG_D5, sim::SIG_D4, sim::SIG_BL
+};
+
+// Two cascaded 595s for initSPI16(): RS/E/BL as on the backpack, then
+// DB0-DB7 on the second chip
+static const sim::Signal CASCADE_595[16] = {
+  sim::SIG_NC, sim::SIG_RS, sim::SIG_E, sim::SIG_NC,
+  sim::SIG_NC, sim::SIG_NC, sim::SIG_NC, sim::SIG_BL,
+  sim::SIG_D0, sim::SIG_D1, sim::SIG_D2, sim::SIG_D3,
+  sim::SIG_D4, sim::SIG_D5, sim::SIG_D6, sim::SIG_D7
+};
+
+// MCP23008 GP0-GP7 on the same backpack in I2C mode
+static const sim::Signal BACKPACK_MCP23008[8] = {
+  sim::SIG_NC, sim::SIG_RS, sim::SIG_E, sim::SIG_D4,
+  sim::SIG_D5, sim::SIG_D6, sim::SIG_D7, sim::SIG_BL
+};
+
+// Power up a fresh board wired for transport t
+inline void rigBoard(Transport t)
+{
+  using sim::board;
+
+  board.reset();
+  switch (t) {
+    case HARDWARE_SPI:
+      board.wire595(A2, SCK, MOSI, BACKPACK_595);
+      break;
+    case SOFTWARE_SPI:
+      board.wire595(D2, D3, D4, BACKPACK_595);
+      break;
+    case CASCADE_SPI:
+      board.wire595(A2, SCK, MOSI, CASCADE_595, 2);
+      break;
+    case I2C_BACKPACK:
+      board.wireMcp23008(0x20, BACKPACK_MCP23008);
+      break;
+    case PARALLEL_4BIT:
+    case PARALLEL_RW:
+    case PARALLEL_8BIT:
+    default:
+      if (t == PARALLEL_RW || t == PARALLEL_8BIT) {
+        board.wirePin(D2, sim::SIG_RW);
+      }
+      if (t == PARALLEL_8BIT) {
+        board.wirePin(D3, sim::SIG_D0);
+        board.wirePin(A0, sim::SIG_D1);
+        board.wirePin(A1, sim::SIG_D2);
+        board.wirePin(A6, sim::SIG_D3);
+      }
+      board.wirePin(D0, sim::SIG_RS);
+      board.wirePin(D1, sim::SIG_E);
+      board.wirePin(D4, sim::SIG_D4);
+      board.wirePin(D5, sim::SIG_D5);
+      board.wirePin(D6, sim::SIG_D6);
+      board.wirePin(D7, sim::SIG_D7);
+      break;
+  }
+}
+
+// Power up a fresh board wired for transport t and return a
+// matching LiquidCrystal (SPI transports are already initSPI()'d)
+inline LiquidCrystal *rigLcd(Transport t)
+{
+  rigBoard(t);
+  LiquidCrystal *lcd = 0;
+  switch (t) {
+    case HARDWARE_SPI:
+      lcd = new LiquidCrystal(A2);
+      lcd->initSPI();
+      break;
+    case SOFTWARE_SPI:
+      lcd = new LiquidCrystal(D2, D3, D4);
+      lcd->initSPI();
+      break;
+    case CASCADE_SPI:
+      lcd = new LiquidCrystal(A2);
+      lcd->initSPI16();
+      break;
+    case I2C_BACKPACK:
+      lcd = new LiquidCrystal(0);
+      lcd->initI2C();
+      break;
+    case PARALLEL_RW:
+      lcd = new LiquidCrystal(D0, D2, D1, D4, D5, D6, D7);
+      break;
+    case PARALLEL_8BIT:
+      lcd = new LiquidCrystal(D0, D2, D1, D3, A0, A1, A6, D4, D5, D6, D7);
+      break;
+    case PARALLEL_4BIT:
+    default:
+      lcd = new LiquidCrystal(D0, D1, D4, D5, D6, D7);
+      break;
+  }
+  return lcd;
+}
+
+// One more display on the SPI rig's clock and data lines (or the SPI
+// bus) with its own 595 latch, for LiquidCrystalBus. Returns it
+// initSPI()'d, n is its display number on the board
+inline LiquidCrystal *rigAnotherLcd(Transport t, uint8_t latchPin, uint8_t *n = 0)
+{
+  uint8_t display = sim::board.wireAnother595(latchPin);
+  if (n) {
+    *n = display;
+  }
+  LiquidCrystal *lcd = t == SOFTWARE_SPI ? new LiquidCrystal(latchPin, D3, D4)
+                                         : new LiquidCrystal(latchPin);
+  if (t == CASCADE_SPI) {
+    lcd->initSPI16();
+  }
+  else {
+    lcd->initSPI();
+  }
+  return lcd;
+}
+
+// Compile-time wired equivalents of the two SPI rigs
+typedef LiquidCrystalT<HardwareSpi595<A2>, AdafruitBackpack595> HardwareSpiLcdT;
+typedef LiquidCrystalT<SoftwareSpi595<D2, D3, D4>, AdafruitBackpack595> SoftwareSpiLcdT;
+
+#endif
@@ -0,0 +1,606 @@
+/*
+ * 74HC595 + HD44780 BEHAVIORAL MODEL
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include <string.h>
+
+#include "lcd-sim.h"
+
+namespace sim {
+
+/* ========= Tables ====================== */
+
+// HD44780U datasheet, VCC = 4.5 - 5.5V, fosc = 270kHz
+const Timing HD44780_TIMING = {
+  40000000, // powerUpNs
+  37000,    // commandNs
+  1520000,  // clearNs
+  41000,    // dataNs (37us + tADD)
+  230,      // pwehNs
+  160,      // tddrNs
+  40,       // tasNs
+  80,       // tdswNs
+  10        // thNs
+};
+
+const Timing WS0010_TIMING = {
+  40000000, // powerUpNs
+  10000,    // commandNs
+  6200000,  // clearNs
+  10000,    // dataNs
+  230,      // pwehNs
+  160,      // tddrNs
+  40,       // tasNs
+  80,       // tdswNs
+  10        // thNs
+};
+
+const PinPort PIN_PORTS[TOTAL_SIM_PINS] = {
+  {1, 7}, {1, 6}, {1, 5}, {1, 4}, {1, 3},     // D0 - D4
+  {0, 15}, {0, 14}, {0, 13},                  // D5 - D7
+  {0xFF, 0}, {0xFF, 0},
+  {0, 0}, {0, 1}, {0, 4}, {0, 5}, {0, 6}, {0, 7}, // A0 - A5
+  {1, 0}, {1, 1},                             // A6 - A7
+  {0, 2}, {0, 3}                              // TX, RX
+};
+
+Board board;
+
+/* ========= HD44780 ===================== */
+
+HD44780::HD44780() : _t(HD44780_TIMING), _cols(16), _rows(2)
+{
+  reset(0);
+}
+
+void HD44780::reset(uint64_t nowPs)
+{
+  // Internal reset circuit: 8-bit, 1 line, display off, increment, cleared
+  _lines = 0;
+  _rsChange = _dataChange = _eRise = _eFall = nowPs;
+  _busyUntil = nowPs + (uint64_t)_t.powerUpNs * 1000;
+  _eightBit = true;
+  _twoLine = false;
+  _bigFont = false;
+  _haveHigh = _haveReadHigh = false;
+  _high = _readFull = _readLatch = 0;
+  memset(_ddram, ' ', sizeof(_ddram));
+  memset(_cgram, 0, sizeof(_cgram));
+  _ac = 0;
+  _acIsCgram = false;
+  _increment = true;
+  _shiftOnWrite = false;
+  _displayOn = _cursorOn = _blinkOn = false;
+  _shift = 0;
+}
+
+void HD44780::drive(uint16_t lines, uint64_t now, Counters &c)
+{
+  uint16_t changed = lines ^ _lines;
+  if (!changed) {
+    return;
+  }
+  bool eWas = _lines & LINE_E;
+  bool eNow = lines & LINE_E;
+
+  // anything but E moving right after a falling edge breaks tH
+  if ((changed & ~(LINE_E | LINE_BL)) && !eWas && now - _eFall < (uint64_t)_t.thNs * 1000) {
+    c.holdViolations++;
+  }
+  if (changed & (LINE_RS | LINE_RW)) {
+    _rsChange = now;
+  }
+  if (changed & 0xFF00) {
+    _dataChange = now;
+  }
+  _lines = lines;
+
+  if (!eWas && eNow) {
+    if (now - _rsChange < (uint64_t)_t.tasNs * 1000) {
+      c.setupViolations++;
+    }
+    _eRise = now;
+    if (_lines & LINE_RW) {
+      bool rs = _lines & LINE_RS;
+      if (_eightBit) {
+        _readLatch = readValue(rs, now);
+      }
+      else if (!_haveReadHigh) {
+        _readFull = readValue(rs, now);
+        _readLatch = _readFull & 0xF0;
+      }
+      else {
+        _readLatch = (_readFull << 4) & 0xF0;
+      }
+    }
+  }
+  else if (eWas && !eNow) {
+    if (now - _eRise < (uint64_t)_t.pwehNs * 1000) {
+      c.pulseViolations++;
+    }
+    if (!(_lines & LINE_RW) && now - _dataChange < (uint64_t)_t.tdswNs * 1000) {
+      c.setupViolations++;
+    }
+    _eFall = now;
+    strobe(now, c);
+  }
+}
+
+bool HD44780::driving() const
+{
+  return (_lines & LINE_RW) && (_lines & LINE_E);
+}
+
+void HD44780::strobe(uint64_t now, Counters &c)
+{
+  bool rs = _lines & LINE_RS;
+
+  if (_lines & LINE_RW) {
+    c.reads++;
+    bool done = _eightBit || _haveReadHigh;
+    if (!_eightBit) {
+      _haveReadHigh = !_haveReadHigh;
+    }
+    if (done && rs) {
+      stepAddress();
+    }
+    return;
+  }
+
+  c.strobes++;
+  if (now < _busyUntil) {
+    c.busyViolations++;
+  }
+
+  uint8_t data = _lines >> 8;
+  if (_eightBit) {
+    execute(data, rs, now, c);
+  }
+  else if (!_haveHigh) {
+    _high = data & 0xF0;
+    _haveHigh = true;
+  }
+  else {
+    _haveHigh = false;
+    execute(_high | (data >> 4), rs, now, c);
+  }
+}
+
+void HD44780::execute(uint8_t v, bool rs, uint64_t now, Counters &c)
+{
+  uint32_t ns = _t.commandNs;
+
+  if (rs) {
+    c.dataWrites++;
+    if (_acIsCgram) {
+      _cgram[_ac & 0x3F] = v;
+    }
+    else {
+      _ddram[_ac & 0x7F] = v;
+      if (_shiftOnWrite) {
+        _shift += _increment ? 1 : -1;
+      }
+    }
+    stepAddress();
+    ns = _t.dataNs;
+  }
+  else {
+    c.instructions++;
+    if (v & 0x80) {           // set DDRAM address
+      _ac = v & 0x7F;
+      _acIsCgram = false;
+    }
+    else if (v & 0x40) {      // set CGRAM address
+      _ac = v & 0x3F;
+      _acIsCgram = true;
+    }
+    else if (v & 0x20) {      // function set
+      if (_eightBit && !(v & 0x10)) {
+        _haveHigh = _haveReadHigh = false;
+      }
+      _eightBit = v & 0x10;
+      _twoLine = v & 0x08;
+      _bigFont = v & 0x04;
+    }
+    else if (v & 0x10) {      // cursor or display shift
+      int dir = (v & 0x04) ? 1 : -1;
+      if (v & 0x08) {
+        _shift -= dir;
+      }
+      else {
+        bool inc = _increment;
+        _increment = dir > 0;
+        stepAddress();
+        _increment = inc;
+      }
+    }
+    else if (v & 0x08) {      // display on/off control
+      _displayOn = v & 0x04;
+      _cursorOn = v & 0x02;
+      _blinkOn = v & 0x01;
+    }
+    else if (v & 0x04) {      // entry mode set
+      _increment = v & 0x02;
+      _shiftOnWrite = v & 0x01;
+    }
+    else if (v & 0x02) {      // return home
+      _ac = 0;
+      _acIsCgram = false;
+      _shift = 0;
+      ns = _t.clearNs;
+    }
+    else if (v & 0x01) {      // clear display
+      memset(_ddram, ' ', sizeof(_ddram));
+      _ac = 0;
+      _acIsCgram = false;
+      _increment = true;
+      _shift = 0;
+      ns = _t.clearNs;
+    }
+  }
+  _busyUntil = now + (uint64_t)ns * 1000;
+}
+
+void HD44780::stepAddress()
+{
+  if (_acIsCgram) {
+    _ac = (_ac + (_increment ? 1 : -1)) & 0x3F;
+  }
+  else if (_twoLine) {
+    if (_increment) {
+      _ac = (_ac == 0x27) ? 0x40 : (_ac == 0x67) ? 0x00 : _ac + 1;
+    }
+    else {
+      _ac = (_ac == 0x00) ? 0x67 : (_ac == 0x40) ? 0x27 : _ac - 1;
+    }
+  }
+  else {
+    if (_increment) {
+      _ac = (_ac >= 0x4F) ? 0x00 : _ac + 1;
+    }
+    else {
+      _ac = (_ac == 0x00) ? 0x4F : _ac - 1;
+    }
+  }
+}
+
+uint8_t HD44780::readValue(bool rs, uint64_t now) const
+{
+  if (rs) {
+    return _acIsCgram ? _cgram[_ac & 0x3F] : _ddram[_ac & 0x7F];
+  }
+  return (now < _busyUntil ? 0x80 : 0x00) | (_ac & 0x7F);
+}
+
+std::string HD44780::row(uint8_t r) const
+{
+  std::string s;
+  int width = _twoLine ? 40 : 80;
+  uint8_t base = (_twoLine && (r & 1)) ? 0x40 : 0x00;
+  int offset = (r >= 2) ? _cols : 0;
+  for (int c = 0; c < _cols; c++) {
+    int pos = ((c + offset + _shift) % width + width) % width;
+    s += (char)_ddram[base + pos];
+  }
+  return s;
+}
+
+/* ========= 74HC595 ===================== */
+
+void ShiftRegister595::clock(bool ser)
+{
+  // QA takes SER, everything else moves one stage towards QH (and QH')
+  _shift = (_shift << 1) | (ser ? 1 : 0);
+  if (_length == 1) {
+    _shift &= 0xFF;
+  }
+}
+
+/* ========= MCP23008 ==================== */
+
+void MCP23008::reset()
+{
+  memset(_regs, 0, sizeof(_regs));
+  _regs[IODIR] = 0xFF;
+  _pointer = 0;
+}
+
+void MCP23008::write(uint8_t value)
+{
+  if (_pointer == GPIO || _pointer == OLAT) {
+    _regs[OLAT] = value;
+    _regs[GPIO] = value;
+  }
+  else if (_pointer < sizeof(_regs)) {
+    _regs[_pointer] = value;
+  }
+  if (!(_regs[IOCON] & SEQOP)) {
+    _pointer = _pointer == OLAT ? 0 : _pointer + 1;
+  }
+}
+
+/* ========= Board ======================= */
+
+Board::Board()
+{
+  reset();
+}
+
+void Board::reset()
+{
+  _ps = 0;
+  _stallNs = 0;
+  memset(&counters, 0, sizeof(counters));
+  memset(_level, 0, sizeof(_level));
+  memset(_mode, 1, sizeof(_mode)); // everything is an input at reset
+  for (int i = 0; i < TOTAL_SIM_PINS; i++) {
+    _pinSignal[i] = SIG_NC;
+  }
+  for (int i = 0; i < 16; i++) {
+    _q[i] = SIG_NC;
+  }
+  _latchPin = _sclkPin = _sdatPin = -1;
+  _lines = 0;
+  sr.reset();
+  sr.setLength(1);
+  lcd.setTiming(HD44780_TIMING);
+  lcd.setGeometry(16, 2);
+  lcd.reset(0);
+  for (int i = 0; i < MAX_SIM_DISPLAYS - 1; i++) {
+    _more[i].sr.reset();
+    _more[i].lcd.setTiming(HD44780_TIMING);
+    _more[i].lcd.setGeometry(16, 2);
+    _more[i].lcd.reset(0);
+    _more[i].latchPin = -1;
+  }
+  _moreCount = 0;
+  for (int i = 0; i < 8; i++) {
+    _gp[i] = SIG_NC;
+  }
+  _i2cAddress = -1;
+  expander.reset();
+}
+
+void Board::wire595(uint8_t latchPin, uint8_t sclkPin, uint8_t sdatPin,
+                    const Signal *q, uint8_t chips)
+{
+  _latchPin = latchPin;
+  _sclkPin = sclkPin;
+  _sdatPin = sdatPin;
+  sr.setLength(chips);
+  for (int i = 0; i < 8 * chips; i++) {
+    _q[i] = q[i];
+  }
+}
+
+uint8_t Board::wireAnother595(uint8_t latchPin)
+{
+  Another595 &m = _more[_moreCount++];
+  m.latchPin = latchPin;
+  m.sr.setLength(sr.length());
+  return _moreCount;
+}
+
+void Board::wireMcp23008(uint8_t address, const Signal *gp)
+{
+  _i2cAddress = address;
+  for (int i = 0; i < 8; i++) {
+    _gp[i] = gp[i];
+  }
+}
+
+void Board::wirePin(uint8_t pin, Signal s)
+{
+  _pinSignal[pin] = s;
+}
+
+void Board::pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin >= TOTAL_SIM_PINS) {
+    return;
+  }
+  counters.pinModes++;
+  _mode[pin] = mode;
+  lcdUpdate();
+}
+
+void Board::pinWrite(uint8_t pin, bool level)
+{
+  if (pin >= TOTAL_SIM_PINS || PIN_PORTS[pin].port == 0xFF) {
+    return;
+  }
+  uint16_t mask = 1 << PIN_PORTS[pin].bit;
+  portWrite(PIN_PORTS[pin].port, level ? mask : 0, level ? 0 : mask);
+}
+
+bool Board::pinRead(uint8_t pin)
+{
+  if (pin >= TOTAL_SIM_PINS) {
+    return false;
+  }
+  Signal s = _pinSignal[pin];
+  if (_mode[pin] != 0 && s >= SIG_D0 && lcd.driving()) {
+    if (!lcd.readValid(_ps)) {
+      counters.readViolations++;
+    }
+    return (lcd.readLatch() >> (s - SIG_D0)) & 1;
+  }
+  return _level[pin];
+}
+
+int8_t Board::pinOf(uint8_t port, uint8_t bit) const
+{
+  for (int i = 0; i < TOTAL_SIM_PINS; i++) {
+    if (PIN_PORTS[i].port == port && PIN_PORTS[i].bit == bit) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void Board::portWrite(uint8_t port, uint16_t set, uint16_t clear)
+{
+  bool old[TOTAL_SIM_PINS];
+  memcpy(old, _level, sizeof(old));
+
+  // BSRR: set wins over reset when both are requested
+  for (int i = 0; i < TOTAL_SIM_PINS; i++) {
+    if (PIN_PORTS[i].port != port) {
+      continue;
+    }
+    uint16_t mask = 1 << PIN_PORTS[i].bit;
+    if (set & mask) {
+      _level[i] = true;
+    }
+    else if (clear & mask) {
+      _level[i] = false;
+    }
+  }
+
+  // SRCLK and RCLK are edge triggered
+  if (_sclkPin >= 0 && !old[_sclkPin] && _level[_sclkPin]) {
+    counters.bitsShifted++;
+    sr.clock(_level[_sdatPin]);
+    for (int i = 0; i < _moreCount; i++) {
+      _more[i].sr.clock(_level[_sdatPin]);
+    }
+  }
+  if (_latchPin >= 0 && !old[_latchPin] && _level[_latchPin]) {
+    counters.latches++;
+    sr.latch();
+  }
+  for (int i = 0; i < _moreCount; i++) {
+    int latch = _more[i].latchPin;
+    if (!old[latch] && _level[latch]) {
+      counters.latches++;
+      _more[i].sr.latch();
+    }
+  }
+  lcdUpdate();
+}
+
+uint16_t Board::portRead(uint8_t port)
+{
+  uint16_t value = 0;
+  for (int i = 0; i < TOTAL_SIM_PINS; i++) {
+    if (PIN_PORTS[i].port == port && pinRead(i)) {
+      value |= 1 << PIN_PORTS[i].bit;
+    }
+  }
+  return value;
+}
+
+void Board::portConfigure(uint8_t port, uint8_t first, uint32_t cr)
+{
+  for (int i = 0; i < TOTAL_SIM_PINS; i++) {
+    uint8_t bit = PIN_PORTS[i].bit;
+    if (PIN_PORTS[i].port == port && bit >= first && bit < first + 8) {
+      _mode[i] = (cr >> (bit - first) * 4) & 0x3 ? 0 : 1;
+    }
+  }
+  lcdUpdate();
+}
+
+// pinMode() OUTPUT is 50MHz push-pull (0x3), INPUT floating (0x4), as
+// is every pin out of reset
+uint32_t Board::portConfiguration(uint8_t port, uint8_t first)
+{
+  uint32_t cr = 0x44444444;
+  for (int i = 0; i < TOTAL_SIM_PINS; i++) {
+    uint8_t bit = PIN_PORTS[i].bit;
+    if (PIN_PORTS[i].port == port && bit >= first && bit < first + 8 && _mode[i] == 0) {
+      cr ^= 0x7UL << (bit - first) * 4;  // 0x4 -> 0x3
+    }
+  }
+  return cr;
+}
+
+void Board::spiTransfer(uint8_t value, bool msbFirst, uint8_t clockDivider)
+{
+  uint32_t div = 2 << (clockDivider >> 3);
+  cycles(CYCLES_SPI_OVERHEAD + 8 * div);
+  counters.spiTransfers++;
+  counters.bitsShifted += 8;
+  for (int i = 0; i < 8; i++) {
+    bool ser = msbFirst ? (value & (0x80 >> i)) : (value & (1 << i));
+    sr.clock(ser);
+    for (int m = 0; m < _moreCount; m++) {
+      _more[m].sr.clock(ser);
+    }
+  }
+}
+
+// LCD lines driven by count outputs q wired as map
+uint16_t Board::signalLines(const Signal *map, uint8_t count, uint16_t q)
+{
+  uint16_t lines = 0;
+  for (int i = 0; i < count; i++) {
+    if (map[i] != SIG_NC && (q & (1 << i))) {
+      lines |= map[i] >= SIG_D0 ? (LINE_D0 << (map[i] - SIG_D0)) : (1 << (map[i] - SIG_RS));
+    }
+  }
+  return lines;
+}
+
+// LCD lines driven by a 595 with outputs q
+uint16_t Board::qLines(uint16_t q) const
+{
+  return signalLines(_q, 16, q);
+}
+
+bool Board::i2cWrite(uint8_t address, const uint8_t *bytes, uint8_t count, uint32_t hz)
+{
+  uint64_t bitPs = 1000000000000ULL / hz;
+  counters.i2cTransactions++;
+  _ps += bitPs;                     // START
+  _ps += 9 * bitPs;                 // address + R/W, ACK
+  counters.bitsShifted += 8;
+  if ((int)address != _i2cAddress) {
+    _ps += bitPs;                   // NACK, STOP
+    return false;
+  }
+  // first byte is the register pointer, the rest are written where it
+  // points, each taking effect on its ACK
+  for (uint8_t i = 0; i < count; i++) {
+    _ps += 9 * bitPs;
+    counters.bitsShifted += 8;
+    if (i == 0) {
+      expander.select(bytes[0]);
+    }
+    else {
+      counters.latches++;
+      expander.write(bytes[i]);
+      lcdUpdate();
+    }
+  }
+  _ps += bitPs;                     // STOP
+  return true;
+}
+
+void Board::lcdUpdate()
+{
+  uint16_t lines = qLines(sr.outputs()) | signalLines(_gp, 8, expander.outputs());
+
+  for (int i = 0; i < TOTAL_SIM_PINS; i++) {
+    Signal s = _pinSignal[i];
+    if (s != SIG_NC && _mode[i] == 0 && _level[i]) {
+      lines |= s >= SIG_D0 ? (LINE_D0 << (s - SIG_D0)) : (1 << (s - SIG_RS));
+    }
+  }
+  _lines = lines;
+  uint32_t strobes = counters.strobes;
+  lcd.drive(lines, _ps, counters);
+  for (int i = 0; i < _moreCount; i++) {
+    _more[i].lcd.drive(qLines(_more[i].sr.outputs()), _ps, counters);
+  }
+  if (_stallNs && counters.strobes != strobes) {
+    _ps += _stallNs * 1000;
+    _stallNs = 0;
+  }
+}
+
+} // namespace sim
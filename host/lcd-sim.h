@@ -0,0 +1,282 @@
+#ifndef LcdSim_h
+#define LcdSim_h
+
+/*
+ * 74HC595 + HD44780 BEHAVIORAL MODEL
+ * =======================================================
+ * A virtual Spark Core (72MHz clock, GPIO ports, SPI, I2C)
+ * wired to a 74HC595 shift register, an MCP23008 I2C expander
+ * and/or directly to an HD44780
+ * controller. The controller model implements DDRAM/CGRAM,
+ * the 8-bit/4-bit nibble state machine, instruction execution
+ * times and the E/RS/data setup, hold and pulse width limits
+ * from the datasheet, and counts every violation it sees.
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include <stdint.h>
+#include <string>
+
+namespace sim {
+
+/* ========= Constants =================== */
+
+const int TOTAL_SIM_PINS = 20;
+const int MAX_SIM_DISPLAYS = 4; // 595 + LCD pairs on one set of clock/data lines
+
+// CPU costs of the Spark wiring calls, in 72MHz cycles
+const uint32_t CYCLES_PIN_MODE      = 150;
+const uint32_t CYCLES_DIGITAL_WRITE = 40;
+const uint32_t CYCLES_DIGITAL_READ  = 40;
+const uint32_t CYCLES_PIN_MAP_LOAD  = 2;
+const uint32_t CYCLES_REG_STORE     = 2;
+const uint32_t CYCLES_SPI_OVERHEAD  = 40;
+const uint32_t CYCLES_NOP4          = 4;
+const uint32_t CYCLES_TIME_READ     = 20;
+
+// LCD bus lines, as seen by the controller
+const uint16_t LINE_RS = 0x0001;
+const uint16_t LINE_RW = 0x0002;
+const uint16_t LINE_E  = 0x0004;
+const uint16_t LINE_BL = 0x0008;
+const uint16_t LINE_D0 = 0x0100; // D0..D7 occupy bits 8..15
+
+// Spark Core pin -> STM32 port/bit (port 0 = GPIOA, 1 = GPIOB, 0xFF = none)
+struct PinPort {
+  uint8_t port;
+  uint8_t bit;
+};
+extern const PinPort PIN_PORTS[TOTAL_SIM_PINS];
+
+// What a pin or a 595 output is connected to
+enum Signal {
+  SIG_NC = 0, SIG_RS, SIG_RW, SIG_E, SIG_BL,
+  SIG_D0, SIG_D1, SIG_D2, SIG_D3, SIG_D4, SIG_D5, SIG_D6, SIG_D7
+};
+
+/* ========= Counters ==================== */
+
+struct Counters {
+  uint32_t latches;         // rising edges on the 595 latch (RCLK)
+  uint32_t bitsShifted;     // rising edges on the 595 shift clock (SRCLK)
+  uint32_t spiTransfers;    // hardware SPI.transfer() calls
+  uint32_t i2cTransactions; // Wire.endTransmission() calls
+  uint32_t digitalWrites;
+  uint32_t pinModes;
+  uint32_t strobes;         // E falling edges with RW low
+  uint32_t instructions;    // complete instruction bytes executed
+  uint32_t dataWrites;      // complete data bytes written to DDRAM/CGRAM
+  uint32_t reads;           // E strobes with RW high
+  uint64_t delayUs;         // total requested through delayMicroseconds()
+  uint32_t busyViolations;  // strobes while the controller was still busy
+  uint32_t setupViolations; // RS/RW changed < tAS before E rose, data < tDSW before E fell
+  uint32_t holdViolations;  // data/RS changed < tH after E fell
+  uint32_t pulseViolations; // E high shorter than PWEH
+  uint32_t readViolations;  // data lines read < tDDR after E rose
+};
+
+/* ========= HD44780 ===================== */
+
+struct Timing {
+  uint32_t powerUpNs;  // controller ignores the bus this long after VCC
+  uint32_t commandNs;  // most instructions
+  uint32_t clearNs;    // clear display / return home
+  uint32_t dataNs;     // DDRAM/CGRAM write
+  uint32_t pwehNs;     // enable pulse width (high level)
+  uint32_t tddrNs;     // read data valid after E rises
+  uint32_t tasNs;      // RS, R/W setup before E rises
+  uint32_t tdswNs;     // data setup before E falls
+  uint32_t thNs;       // address/data hold after E falls
+};
+
+// HD44780U datasheet values at VCC = 2.7 - 4.5V (worst case)
+extern const Timing HD44780_TIMING;
+// Winstar OLED controller: slow clear, everything else under 10us
+extern const Timing WS0010_TIMING;
+
+class HD44780 {
+public:
+  HD44780();
+  void reset(uint64_t nowPs);
+  void setTiming(const Timing &t) { _t = t; }
+  void setGeometry(uint8_t cols, uint8_t rows) { _cols = cols; _rows = rows; }
+
+  // Called whenever any line on the LCD connector changes
+  void drive(uint16_t lines, uint64_t nowPs, Counters &c);
+  // Level the controller drives on D0..D7 while reading (RW high, E high)
+  bool driving() const;
+  uint8_t readLatch() const { return _readLatch; }
+  bool readValid(uint64_t nowPs) const { return nowPs - _eRise >= (uint64_t)_t.tddrNs * 1000; }
+
+  std::string row(uint8_t r) const;      // what is visible on row r
+  uint8_t ddram(uint8_t addr) const { return _ddram[addr & 0x7F]; }
+  uint8_t cgram(uint8_t addr) const { return _cgram[addr & 0x3F]; }
+  uint8_t addressCounter() const { return _ac; }
+  bool busy(uint64_t nowPs) const { return nowPs < _busyUntil; }
+
+  bool eightBit() const { return _eightBit; }
+  bool twoLine() const { return _twoLine; }
+  bool displayOn() const { return _displayOn; }
+  bool cursorOn() const { return _cursorOn; }
+  bool blinkOn() const { return _blinkOn; }
+  bool entryIncrement() const { return _increment; }
+  bool entryShift() const { return _shiftOnWrite; }
+  int displayShift() const { return _shift; }
+  bool backlight() const { return _lines & LINE_BL; }
+
+private:
+  void strobe(uint64_t nowPs, Counters &c);
+  void execute(uint8_t value, bool rs, uint64_t nowPs, Counters &c);
+  void stepAddress();
+  uint8_t readValue(bool rs, uint64_t nowPs) const;
+
+  Timing _t;
+  uint16_t _lines;
+  uint64_t _rsChange, _dataChange, _eRise, _eFall;
+  uint64_t _busyUntil;
+
+  bool _eightBit, _twoLine, _bigFont;
+  bool _haveHigh, _haveReadHigh;
+  uint8_t _high;
+  uint8_t _readFull, _readLatch;
+
+  uint8_t _ddram[128];
+  uint8_t _cgram[64];
+  uint8_t _ac;
+  bool _acIsCgram;
+  bool _increment, _shiftOnWrite;
+  bool _displayOn, _cursorOn, _blinkOn;
+  int _shift;
+
+  uint8_t _cols, _rows;
+};
+
+/* ========= 74HC595 ===================== */
+
+class ShiftRegister595 {
+public:
+  ShiftRegister595() : _length(1), _shift(0), _outputs(0) {}
+  void reset() { _shift = 0; _outputs = 0; }
+  void setLength(uint8_t chips) { _length = chips; }
+  uint8_t length() const { return _length; }
+  void clock(bool ser);
+  void latch() { _outputs = _shift; }
+  uint16_t outputs() const { return _outputs; }
+
+private:
+  uint8_t _length;  // number of daisy chained chips (1 or 2)
+  uint16_t _shift;
+  uint16_t _outputs;
+};
+
+/* ========= MCP23008 ==================== */
+
+// I2C GPIO expander: IODIR, IOCON (SEQOP) and GPIO/OLAT, which is all
+// an LCD backpack uses. Power-on state is all inputs, pointer increment.
+class MCP23008 {
+public:
+  MCP23008() { reset(); }
+  void reset();
+  void select(uint8_t reg) { _pointer = reg; }
+  void write(uint8_t value);   // to the register the pointer is on
+  uint8_t outputs() const { return _regs[OLAT] & ~_regs[IODIR]; }
+  uint8_t reg(uint8_t r) const { return _regs[r % 11]; }
+
+  static const uint8_t IODIR = 0x00;
+  static const uint8_t IOCON = 0x05;
+  static const uint8_t GPIO = 0x09;
+  static const uint8_t OLAT = 0x0A;
+  static const uint8_t SEQOP = 0x20;
+
+private:
+  uint8_t _regs[11];
+  uint8_t _pointer;
+};
+
+/* ========= Board ======================= */
+
+class Board {
+public:
+  Board();
+
+  // Start over: power up the LCD at t = 0, clear wiring and counters
+  void reset();
+
+  // Wiring. Q outputs of the 595 are numbered 0-7 (QA-QH), 8-15 on a 2nd chip
+  void wire595(uint8_t latchPin, uint8_t sclkPin, uint8_t sdatPin,
+               const Signal *q, uint8_t chips = 1);
+  void wirePin(uint8_t pin, Signal s);
+  // One more 595 + LCD on the same clock/data lines and Q wiring as the
+  // first, latched by its own pin. Returns its display number (1, 2, ...)
+  uint8_t wireAnother595(uint8_t latchPin);
+  // MCP23008 at I2C address, GP0-GP7 wired to gp[0..7]
+  void wireMcp23008(uint8_t address, const Signal *gp);
+
+  // Clock
+  void cycles(uint32_t n) { _ps += (uint64_t)n * 125000 / 9; }  // 13.889ns
+  void advanceNs(uint64_t ns) { _ps += ns * 1000; }
+  uint64_t nowPs() const { return _ps; }
+  uint64_t nowNs() const { return _ps / 1000; }
+  uint64_t nowUs() const { return _ps / 1000000; }
+  // An interrupt holding the CPU for ns right after the next E strobe
+  void interruptAfterStrobe(uint64_t ns) { _stallNs = ns; }
+
+  // Pins (Spark numbering) and raw GPIO ports
+  void pinMode(uint8_t pin, uint8_t mode);
+  void pinWrite(uint8_t pin, bool level);
+  bool pinRead(uint8_t pin);
+  void portWrite(uint8_t port, uint16_t set, uint16_t clear);
+  uint16_t portRead(uint8_t port);
+  // CRL (first 0) or CRH (first 8): 4 bits a pin, output when MODE isn't 0
+  void portConfigure(uint8_t port, uint8_t first, uint32_t cr);
+  uint32_t portConfiguration(uint8_t port, uint8_t first);
+  int8_t pinOf(uint8_t port, uint8_t bit) const;
+
+  // Hardware SPI peripheral: shifts a byte straight into the 595
+  void spiTransfer(uint8_t value, bool msbFirst, uint8_t clockDivider);
+  // I2C master: one write transaction (START, address, bytes, STOP),
+  // false if nothing acknowledged the address
+  bool i2cWrite(uint8_t address, const uint8_t *bytes, uint8_t count, uint32_t hz);
+
+  MCP23008 expander;
+
+  HD44780 lcd;
+  ShiftRegister595 sr;
+  Counters counters;
+
+  // Display 0 is lcd, the rest were added by wireAnother595()
+  HD44780 &display(uint8_t n) { return n ? _more[n - 1].lcd : lcd; }
+
+private:
+  void lcdUpdate();
+  uint16_t qLines(uint16_t q) const;
+  static uint16_t signalLines(const Signal *map, uint8_t count, uint16_t q);
+
+  struct Another595 {
+    ShiftRegister595 sr;
+    HD44780 lcd;
+    int latchPin;
+  };
+
+  uint64_t _ps;
+  uint64_t _stallNs;
+  bool _level[TOTAL_SIM_PINS];
+  uint8_t _mode[TOTAL_SIM_PINS];
+  Signal _pinSignal[TOTAL_SIM_PINS];
+  Signal _q[16];
+  int _latchPin, _sclkPin, _sdatPin;
+  uint16_t _lines;
+  Signal _gp[8];
+  int _i2cAddress;
+  Another595 _more[MAX_SIM_DISPLAYS - 1];
+  uint8_t _moreCount;
+};
+
+extern Board board;
+
+} // namespace sim
+
+#endif
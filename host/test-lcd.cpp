@@ -0,0 +1,1421 @@
+/*
+ * HOST REGRESSION TESTS
+ * =======================================================
+ * Drives LiquidCrystal against the simulated 74HC595 and
+ * HD44780 and checks what ends up on the glass, in DDRAM and
+ * CGRAM, and that no datasheet timing was violated on the way.
+ * =======================================================
+ * https://github.com/technobly/SparkCore-LiquidCrystalSPI
+ */
+
+/* ========= INCLUDES ==================== */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "lcd-rig.h"
+
+using sim::board;
+
+/* ========= Harness ===================== */
+
+static int failures = 0;
+static int checks = 0;
+
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+#define CHECK_ROW(r, text) checkRow((r), (text), __FILE__, __LINE__)
+
+static void check(bool ok, const char *what, const char *file, int line)
+{
+  checks++;
+  if (!ok) {
+    failures++;
+    printf("  FAIL %s:%d: %s\n", file, line, what);
+  }
+}
+
+static void checkRow(uint8_t r, const std::string &text, const char *file, int line)
+{
+  std::string row = board.lcd.row(r);
+  checks++;
+  if (row != text) {
+    failures++;
+    printf("  FAIL %s:%d: row %d is \"%s\", expected \"%s\"\n",
+           file, line, r, row.c_str(), text.c_str());
+  }
+}
+
+static void checkTiming(const char *file, int line)
+{
+  const sim::Counters &c = board.counters;
+  check(c.busyViolations == 0, "no busy violations", file, line);
+  check(c.setupViolations == 0, "no setup violations", file, line);
+  check(c.holdViolations == 0, "no hold violations", file, line);
+  check(c.pulseViolations == 0, "no enable pulse violations", file, line);
+  check(c.readViolations == 0, "no read data violations", file, line);
+}
+#define CHECK_TIMING() checkTiming(__FILE__, __LINE__)
+
+// Compare text with golden/<name>.txt, or rewrite that file when
+// LCD_UPDATE_GOLDEN is set (make golden)
+static void checkGolden(const char *name, const std::string &text, const char *file, int line)
+{
+  std::string path = std::string("golden/") + name + ".txt";
+  checks++;
+  if (getenv("LCD_UPDATE_GOLDEN")) {
+    FILE *f = fopen(path.c_str(), "w");
+    if (f) {
+      fputs(text.c_str(), f);
+      fclose(f);
+      return;
+    }
+  }
+  std::string golden;
+  FILE *f = fopen(path.c_str(), "r");
+  if (f) {
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      golden.append(buf, n);
+    }
+    fclose(f);
+  }
+  if (text != golden) {
+    failures++;
+    size_t at = 0;
+    while (at < text.size() && at < golden.size() && text[at] == golden[at]) {
+      at++;
+    }
+    size_t start = text.rfind('\n', at) == std::string::npos ? 0 : text.rfind('\n', at) + 1;
+    printf("  FAIL %s:%d: differs from %s at \"%s\"\n", file, line, path.c_str(),
+           text.substr(start, text.find('\n', start) - start).c_str());
+  }
+}
+#define CHECK_GOLDEN(name, text) checkGolden((name), (text), __FILE__, __LINE__)
+
+static bool eightBit(Transport t)
+{
+  return t == CASCADE_SPI || t == PARALLEL_8BIT;
+}
+
+// RW is wired and the busy flag can be read
+static bool readable(Transport t)
+{
+  return t == PARALLEL_RW || t == PARALLEL_8BIT;
+}
+
+// E strobes per instruction or character: one in 8-bit mode
+static uint32_t strobesPerByte(Transport t)
+{
+  return eightBit(t) ? 1 : 2;
+}
+
+/* ========= Tests ======================= */
+
+static void testBeginAndPrint(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  CHECK(board.lcd.eightBit() == eightBit(t));
+  CHECK(board.lcd.twoLine());
+  CHECK(board.lcd.displayOn());
+  CHECK(!board.lcd.cursorOn());
+  CHECK(!board.lcd.blinkOn());
+
+  lcd->print("Hello, Sparky!");
+  lcd->setCursor(0, 1);
+  lcd->print(1234);
+  CHECK_ROW(0, "Hello, Sparky!  ");
+  CHECK_ROW(1, "1234            ");
+  CHECK(board.lcd.addressCounter() == 0x44);
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testClearHome(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->print("garbage");
+  lcd->clear();
+  CHECK_ROW(0, "                ");
+  lcd->print("ab");
+  lcd->home();
+  lcd->print("X");
+  CHECK_ROW(0, "Xb              ");
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testCreateChar(Transport t)
+{
+  uint8_t heart[8] = { 0x00, 0x0A, 0x1F, 0x1F, 0x0E, 0x04, 0x00, 0x00 };
+
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->createChar(3, heart);
+  for (int i = 0; i < 8; i++) {
+    CHECK(board.lcd.cgram(3 * 8 + i) == heart[i]);
+  }
+  lcd->setCursor(5, 0);
+  lcd->write(3);
+  CHECK(board.lcd.ddram(0x05) == 3);
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testGlyphCache(Transport t)
+{
+  static const uint8_t icons[10][8] = {
+    { 0x04, 0x0E, 0x1F, 0x04, 0x04, 0x04, 0x04, 0x00 },
+    { 0x04, 0x04, 0x04, 0x04, 0x1F, 0x0E, 0x04, 0x00 },
+    { 0x00, 0x0A, 0x1F, 0x1F, 0x0E, 0x04, 0x00, 0x00 },
+    { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x1B, 0x1F, 0x00 },
+    { 0x0E, 0x1B, 0x11, 0x11, 0x1F, 0x1F, 0x1F, 0x00 },
+    { 0x01, 0x03, 0x05, 0x09, 0x09, 0x0B, 0x1B, 0x18 },
+    { 0x00, 0x0E, 0x15, 0x17, 0x11, 0x0E, 0x00, 0x00 },
+    { 0x04, 0x0A, 0x0A, 0x0E, 0x0E, 0x1F, 0x1F, 0x0E },
+    { 0x1F, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x1F, 0x00 },
+    { 0x00, 0x01, 0x03, 0x16, 0x1C, 0x08, 0x00, 0x00 },
+  };
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->print("T:");
+
+  // first use uploads, the cursor stays where it was
+  uint8_t up = lcd->glyph(100, icons[0]);
+  lcd->write(up);
+  CHECK(lcd->glyphMisses() == 1 && lcd->glyphHits() == 0);
+  CHECK(board.lcd.ddram(0x02) == up);
+  for (int i = 0; i < 8; i++) {
+    CHECK(board.lcd.cgram(up * 8 + i) == icons[0][i]);
+  }
+
+  // redrawing the same icon is free on the bus
+  uint32_t data = board.counters.dataWrites;
+  lcd->setCursor(3, 0);
+  lcd->writeGlyph(100, icons[0]);
+  CHECK(board.counters.dataWrites - data == 1);
+  CHECK(board.lcd.ddram(0x03) == up);
+  CHECK(lcd->glyphHits() == 1);
+
+  // same id, new bitmap: uploaded again
+  uint8_t again = lcd->glyph(100, icons[1]);
+  CHECK(lcd->glyphMisses() == 2);
+  CHECK(board.lcd.cgram(again * 8 + 4) == icons[1][4]);
+
+  // after createChar() the cursor is in CGRAM: glyph() leaves it at 0,0
+  // rather than have the write() land on top of a bitmap
+  lcd->createChar(7, icons[9]);
+  uint8_t fresh = lcd->glyph(200, icons[8]);
+  lcd->write(fresh);
+  CHECK(board.lcd.ddram(0x00) == fresh);
+  for (int i = 0; i < 8; i++) {
+    CHECK(board.lcd.cgram(fresh * 8 + i) == icons[8][i]);
+    CHECK(board.lcd.cgram(7 * 8 + i) == icons[9][i] || fresh == 7);
+  }
+
+  // fill the slots with icons 1-8 on screen, then take icon 3 off it
+  lcd->clear();
+  uint8_t slot[10];
+  for (int i = 1; i <= 8; i++) {
+    slot[i] = lcd->glyph(i, icons[i - 1]);
+    lcd->write(slot[i]);
+  }
+  lcd->clear();
+  for (int i = 1; i <= 8; i++) {
+    if (i != 3) {
+      lcd->write(slot[i]);
+    }
+  }
+  // icon 1 is the least recently used, but it is showing
+  slot[9] = lcd->glyph(9, icons[8]);
+  CHECK(slot[9] == slot[3]);
+  lcd->write(slot[9]);
+  CHECK_ROW(0, std::string() + (char)slot[1] + (char)slot[2] + (char)slot[4] + (char)slot[5] +
+               (char)slot[6] + (char)slot[7] + (char)slot[8] + (char)slot[9] + "        ");
+  CHECK(board.lcd.cgram(slot[1] * 8 + 2) == icons[0][2]);  // untouched
+
+  // all showing: the least recently used goes (icon 1)
+  uint8_t tenth = lcd->glyph(10, icons[9]);
+  CHECK(tenth == slot[1]);
+
+  // createChar() takes a slot back from the cache
+  lcd->createChar(slot[2], icons[0]);
+  uint32_t misses = lcd->glyphMisses();
+  lcd->glyph(2, icons[1]);
+  CHECK(lcd->glyphMisses() == misses + 1);
+
+  // framebuffer mode: visibility comes from the framebuffer
+  lcd->framebuffer();
+  lcd->clear();
+  lcd->flush();
+  lcd->setCursor(0, 1);
+  lcd->writeGlyph(1, icons[0]);
+  lcd->writeGlyph(5, icons[4]);
+  lcd->flush();
+  std::string row1 = board.lcd.row(1);
+  CHECK((uint8_t)row1[0] < 8 && (uint8_t)row1[1] < 8);
+  CHECK(board.lcd.cgram((uint8_t)row1[0] * 8 + 1) == icons[0][1]);
+  CHECK(board.lcd.cgram((uint8_t)row1[1] * 8 + 1) == icons[4][1]);
+  lcd->noFramebuffer();
+  CHECK_TIMING();
+
+  // begin() starts over, CGRAM is unknown after a reset
+  lcd->begin(16, 2);
+  misses = lcd->glyphMisses();
+  lcd->glyph(1, icons[0]);
+  CHECK(lcd->glyphMisses() == misses + 1);
+  delete lcd;
+}
+
+static void testWidgets(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  LcdBarGraph bar(*lcd, 0, 1, 16);
+
+  bar.draw(50, 100);  // 40 of 80 steps
+  CHECK_ROW(1, std::string(8, '\xFF') + "        ");
+
+  // one partial cell, uploaded on first use
+  uint32_t data = board.counters.dataWrites;
+  bar.draw(53, 100);
+  uint8_t partial = board.lcd.ddram(0x48);
+  CHECK(partial < 8);
+  CHECK(board.lcd.cgram(partial * 8) == 0x18);
+  CHECK(board.counters.dataWrites - data == 8 + 1);
+
+  // back and forth: one cell each time, glyphs already loaded
+  bar.draw(51, 100);
+  data = board.counters.dataWrites;
+  uint32_t instructions = board.counters.instructions;
+  bar.draw(53, 100);
+  CHECK(board.counters.dataWrites - data == 1);
+  CHECK(board.counters.instructions - instructions <= 1);
+  data = board.counters.dataWrites;
+  bar.draw(53, 100);
+  CHECK(board.counters.dataWrites == data);  // nothing changed
+  bar.draw(200, 100);
+  CHECK_ROW(1, std::string(16, '\xFF'));
+  bar.draw(0, 100);
+  CHECK_ROW(1, "                ");
+
+  // big numbers: leading blanks, only the changed digit is rewritten
+  lcd->clear();
+  LcdBigNumber big(*lcd, 0, 0, 4);
+  big.draw(7);
+  CHECK(board.lcd.row(0).substr(0, 12) == "            ");
+  CHECK(board.lcd.row(0)[15] == ' ');
+  big.draw(1234);
+  std::string top = board.lcd.row(0), bottom = board.lcd.row(1);
+  data = board.counters.dataWrites;
+  big.draw(1235);
+  CHECK(board.counters.dataWrites - data <= 6);
+  CHECK(board.lcd.row(0).substr(0, 12) == top.substr(0, 12));
+  CHECK(board.lcd.row(1).substr(0, 12) == bottom.substr(0, 12));
+  data = board.counters.dataWrites;
+  big.draw(1235);
+  CHECK(board.counters.dataWrites == data);
+
+  // '8' is every segment but the two bars: check it against CGRAM
+  big.draw(8);
+  uint8_t lt = board.lcd.ddram(0x0C), lb = board.lcd.ddram(0x4D);
+  CHECK(lt < 8 && lb < 8);
+  CHECK(board.lcd.cgram(lt * 8) == 0x07 && board.lcd.cgram(lt * 8 + 7) == 0x1F);
+  CHECK(board.lcd.cgram(lb * 8) == 0x1F && board.lcd.cgram(lb * 8 + 1) == 0x00);
+
+  // after a clear() the widget has to be told to draw everything
+  lcd->clear();
+  big.redraw();
+  big.draw(8);
+  CHECK(board.lcd.ddram(0x0C) == lt);
+
+  // no digits asked for still gets one, not a 255 cell row
+  lcd->clear();
+  LcdBigNumber one(*lcd, 0, 0, 0);
+  one.draw(42);  // the 2
+  CHECK(board.lcd.ddram(0x00) < 8 && board.lcd.ddram(0x00) == board.lcd.ddram(0x01));
+  CHECK(board.lcd.row(0).substr(3) == std::string(13, ' '));
+  CHECK(board.lcd.row(1).substr(3) == std::string(13, ' '));
+  CHECK_TIMING();
+  delete lcd;
+}
+
+// what a marquee of period chars should show after n steps
+static std::string marqueeView(const std::string &text, size_t period, int n)
+{
+  std::string s;
+  for (int c = 0; c < 16; c++) {
+    size_t pos = (n + c) % period;
+    s += pos < text.size() ? text[pos] : ' ';
+  }
+  return s;
+}
+
+static void testMarquee(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+
+  // fits in a DDRAM row: written once, then one command per step
+  std::string text = "Short and sweet";
+  LcdMarquee marquee(*lcd, 0, 16);
+  marquee.begin(text.c_str());
+  CHECK_ROW(0, marqueeView(text, 40, 0));
+  uint32_t data = board.counters.dataWrites;
+  uint32_t instructions = board.counters.instructions;
+  bool ok = true;
+  for (int n = 1; n <= 100; n++) {
+    marquee.step();
+    ok = ok && board.lcd.row(0) == marqueeView(text, 40, n);
+  }
+  CHECK(ok);
+  CHECK(board.counters.dataWrites == data);
+  CHECK(board.counters.instructions - instructions == 100);
+
+  // longer than a row: the columns out of view are refilled in bursts
+  text = "The quick brown fox jumps over the lazy dog, twice over.";
+  marquee.begin(text.c_str(), 4);
+  CHECK_ROW(0, marqueeView(text, text.size() + 4, 0));
+  data = board.counters.dataWrites;
+  ok = true;
+  for (int n = 1; n <= 200; n++) {
+    marquee.step();
+    ok = ok && board.lcd.row(0) == marqueeView(text, text.size() + 4, n);
+  }
+  CHECK(ok);
+  CHECK(board.counters.dataWrites - data <= 200 + 24);
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testNumberFields(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->print("T:");
+  CHECK(lcd->printNumber(2, 0, 6, 1234) == 4);  // the padding is blank already
+  CHECK_ROW(0, "T:  1234        ");
+
+  // one digit moved: one data write, the address is the only command
+  uint32_t data = board.counters.dataWrites;
+  uint32_t instructions = board.counters.instructions;
+  CHECK(lcd->printNumber(2, 0, 6, 1235) == 1);
+  CHECK(board.counters.dataWrites - data == 1);
+  CHECK(board.counters.instructions - instructions <= 1);
+  CHECK(lcd->printNumber(2, 0, 6, 1235) == 0);
+  CHECK(board.counters.dataWrites - data == 1);
+  CHECK_ROW(0, "T:  1235        ");
+
+  lcd->printNumber(2, 0, 6, -42);
+  CHECK_ROW(0, "T:   -42        ");
+  lcd->printNumber(2, 0, 6, 2150, 2);
+  CHECK_ROW(0, "T: 21.50        ");
+  lcd->printNumber(2, 0, 6, -5, 2);
+  CHECK_ROW(0, "T: -0.05        ");
+  lcd->printNumber(2, 0, 6, 0, 1);
+  CHECK_ROW(0, "T:   0.0        ");
+  lcd->printNumber(2, 0, 6, 1234567);
+  CHECK_ROW(0, "T:######        ");
+  lcd->printNumber(2, 0, 6, -99999);
+  CHECK_ROW(0, "T:-99999        ");
+  lcd->printNumber(2, 0, 6, (int32_t)0x80000000);
+  CHECK_ROW(0, "T:######        ");
+  lcd->printHex(12, 0, 4, 0xBEEF);
+  lcd->printHex(0, 1, 4, 0x2A);
+  lcd->printHex(6, 1, 2, 0x123);
+  CHECK_ROW(0, "T:######    BEEF");
+  CHECK_ROW(1, "002A  ##        ");
+
+  // writes through print() keep the shadow right
+  lcd->setCursor(0, 1);
+  lcd->print("0");
+  CHECK(lcd->printHex(0, 1, 4, 0x2A) == 0);
+  lcd->setCursor(1, 1);
+  lcd->print("1");
+  CHECK(lcd->printHex(0, 1, 4, 0x2A) == 1);
+  lcd->clear();
+  CHECK(lcd->printHex(0, 1, 4, 0x2A) == 4);
+  CHECK_ROW(1, "002A            ");
+
+  // in framebuffer mode the field changes land in the framebuffer
+  lcd->framebuffer();
+  data = board.counters.dataWrites;
+  CHECK(lcd->printNumber(0, 1, 4, 7, 1) == 3);  // over "002A"
+  CHECK(lcd->printNumber(0, 1, 4, 7, 1) == 0);
+  CHECK(board.counters.dataWrites == data);
+  lcd->flush();
+  CHECK_ROW(1, " 0.7            ");
+  lcd->noFramebuffer();
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testScheduler(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  LcdScheduler screen(*lcd, 60000);
+  int8_t temp = screen.region(0, 0, 6, 1, 10);  // 10Hz
+  int8_t name = screen.region(8, 0, 8, 2);
+  CHECK(temp == 0 && name == 1);
+
+  // a burst of values coalesces to the last one
+  uint32_t data = board.counters.dataWrites;
+  for (int32_t v = 2000; v < 2100; v++) {
+    screen.setNumber(temp, v, 2);
+  }
+  screen.set(name, "Kitchen");
+  screen.tick();
+  CHECK_ROW(0, " 20.99  Kitchen ");
+  CHECK(board.counters.dataWrites - data == 5 + 7);
+  CHECK(!screen.pending());
+
+  // held back until 100ms after the last update, then sent once
+  screen.setNumber(temp, 2150, 2);
+  board.advanceNs(50 * 1000000ULL);
+  screen.tick();
+  CHECK_ROW(0, " 20.99  Kitchen ");
+  CHECK(screen.pending());
+  board.advanceNs(50 * 1000000ULL);
+  screen.tick();
+  CHECK_ROW(0, " 21.50  Kitchen ");
+  CHECK(!screen.pending());
+
+  // a budget below one cell sends one cell per tick, by priority
+  screen.setBudget(1);
+  board.advanceNs(100 * 1000000ULL);
+  screen.setNumber(temp, 2260, 2);
+  screen.set(name, "Garage");
+  screen.tick();
+  CHECK_ROW(0, " 21.50  Gitchen ");
+  int ticks = 1;
+  while (screen.pending() && ticks < 100) {
+    screen.tick();
+    ticks++;
+  }
+  CHECK_ROW(0, " 22.60  Garage  ");
+  CHECK(ticks == 7 + 2);  // "Garage " and the two changed digits
+
+  // new text for a partly sent region goes out on the next ticks
+  board.advanceNs(100 * 1000000ULL);
+  screen.setNumber(temp, 2370, 2);
+  screen.tick();
+  CHECK_ROW(0, " 23.60  Garage  ");
+  screen.setNumber(temp, 2480, 2);
+  ticks = 0;
+  while (screen.pending() && ticks < 20) {
+    screen.tick();
+    ticks++;
+  }
+  CHECK_ROW(0, " 24.80  Garage  ");
+  CHECK(ticks == 3);  // two changed cells, then the unchanged tail
+
+  // a realistic budget is kept whenever a cell fits in it
+  screen.setBudget(2000);
+  board.advanceNs(100 * 1000000ULL);
+  screen.setNumber(temp, -1234, 2);
+  screen.set(name, "Basement");
+  bool ok = true;
+  ticks = 0;
+  while (screen.pending() && ticks < 100) {
+    uint64_t before = board.nowUs();
+    uint32_t used = screen.tick();
+    ok = ok && used <= 2000 && board.nowUs() - before <= 2000 + 2;
+    ticks++;
+  }
+  CHECK(ok);
+  CHECK_ROW(0, "-12.34  Basement");
+
+  // after clear() every region goes out again
+  lcd->clear();
+  screen.redraw();
+  board.advanceNs(100 * 1000000ULL);
+  while (screen.pending() && ticks < 200) {
+    screen.tick();
+    ticks++;
+  }
+  CHECK_ROW(0, "-12.34  Basement");
+
+  // one cell held up by an interrupt only slows the next few ticks
+  screen.setBudget(1);
+  screen.set(name, "aaaaaaaa");
+  uint64_t before = board.nowNs();
+  screen.tick();
+  uint32_t cell = (board.nowNs() - before) / 1000;  // with its address command
+  screen.setBudget(6 * cell);
+  int cells[40];
+  for (int n = 0; n < 40; n++) {
+    if (n == 20) {
+      board.interruptAfterStrobe(20 * cell * 1000ULL);
+    }
+    screen.set(name, std::string(8, 'A' + n % 26).c_str());
+    data = board.counters.dataWrites;
+    screen.tick();
+    cells[n] = board.counters.dataWrites - data;
+  }
+  CHECK(cells[19] >= 2);
+  CHECK(cells[20] == 1 && cells[21] < cells[19]);
+  CHECK(cells[39] == cells[19]);
+
+  // a tick held up past 65ms reports all of it
+  screen.set(name, "zzzzzzzz");
+  board.interruptAfterStrobe(70000 * 1000ULL);
+  before = board.nowNs();
+  uint32_t spent = screen.tick();
+  CHECK(spent >= 70000 && spent <= (board.nowNs() - before) / 1000 + 1);
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testDisplayControls(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->cursor();
+  lcd->blink();
+  CHECK(board.lcd.displayOn());
+  CHECK(board.lcd.cursorOn());
+  CHECK(board.lcd.blinkOn());
+  lcd->noDisplay();
+  CHECK(!board.lcd.displayOn());
+  CHECK(board.lcd.cursorOn());
+  lcd->display();
+  lcd->noCursor();
+  lcd->noBlink();
+  CHECK(board.lcd.displayOn());
+  CHECK(!board.lcd.cursorOn());
+  CHECK(!board.lcd.blinkOn());
+
+  lcd->rightToLeft();
+  CHECK(!board.lcd.entryIncrement());
+  lcd->leftToRight();
+  lcd->autoscroll();
+  CHECK(board.lcd.entryIncrement());
+  CHECK(board.lcd.entryShift());
+  lcd->noAutoscroll();
+  CHECK(!board.lcd.entryShift());
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testScroll(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->print("0123456789");
+  lcd->scrollDisplayLeft();
+  lcd->scrollDisplayLeft();
+  CHECK_ROW(0, "23456789        ");
+  lcd->scrollDisplayRight();
+  CHECK_ROW(0, "123456789       ");
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testBacklight(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  CHECK(!board.lcd.backlight());
+  lcd->backlight();
+  CHECK(board.lcd.backlight());
+  lcd->print("lit");
+  CHECK(board.lcd.backlight());
+  lcd->noBacklight();
+  CHECK(!board.lcd.backlight());
+  CHECK_ROW(0, "lit             ");
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testFourRows(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  board.lcd.setGeometry(20, 4);
+  lcd->begin(20, 4);
+  for (uint8_t r = 0; r < 4; r++) {
+    lcd->setCursor(r, r);
+    lcd->print("row");
+  }
+  CHECK_ROW(0, "row                 ");
+  CHECK_ROW(1, " row                ");
+  CHECK_ROW(2, "  row               ");
+  CHECK_ROW(3, "   row              ");
+
+  // a row past the last goes to the last, row_offsets[] has only 4
+  lcd->setCursor(0, 4);
+  lcd->print("end");
+  CHECK_ROW(3, "endrow              ");
+  lcd->setCursor(0, 255);
+  lcd->print("E");
+  CHECK_ROW(3, "Endrow              ");
+  CHECK_TIMING();
+  delete lcd;
+
+  lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->setCursor(0, 2);
+  lcd->print("two");
+  CHECK_ROW(0, "                ");
+  CHECK_ROW(1, "two             ");
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testNibbleTransfers(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->write('a');  // RS goes high: one extra transfer
+
+  // two latches per nibble, cascaded 595s send the whole byte at once
+  uint32_t perByte = t == CASCADE_SPI ? 2 : 4;
+  uint32_t latches = board.counters.latches;
+  lcd->print("bcd");
+  CHECK(board.counters.latches - latches == 3 * perByte);
+
+  latches = board.counters.latches;
+  lcd->setCursor(0, 1);
+  lcd->write('e');
+  CHECK(board.counters.latches - latches == 2 * (1 + perByte));
+  CHECK_ROW(0, "abcd            ");
+  CHECK_ROW(1, "e               ");
+  CHECK(board.lcd.eightBit() == eightBit(t));
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testFramebuffer(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->framebuffer();
+  lcd->print("Temp: 21.5C");
+  lcd->setCursor(0, 1);
+  lcd->print("Hum:  40%");
+  CHECK_ROW(0, "                ");
+  lcd->flush();
+  CHECK_ROW(0, "Temp: 21.5C     ");
+  CHECK_ROW(1, "Hum:  40%       ");
+
+  // nothing changed: nothing sent
+  uint32_t strobes = board.counters.strobes;
+  lcd->home();
+  lcd->print("Temp: 21.5C");
+  lcd->flush();
+  CHECK(board.counters.strobes == strobes);
+
+  // "21.5" -> "22.0": one address + 3 cells (the '.' is bridged)
+  lcd->setCursor(6, 0);
+  lcd->print("22.0");
+  lcd->flush();
+  CHECK(board.counters.strobes - strobes == strobesPerByte(t) * (1 + 3));
+  CHECK_ROW(0, "Temp: 22.0C     ");
+
+  // the run after "40" starts where the cursor already is
+  strobes = board.counters.strobes;
+  lcd->setCursor(6, 1);
+  lcd->print("55");
+  lcd->flush();
+  lcd->setCursor(8, 1);
+  lcd->print("#");
+  lcd->flush();
+  CHECK(board.counters.strobes - strobes == strobesPerByte(t) * (1 + 2 + 1));
+  CHECK_ROW(1, "Hum:  55#       ");
+
+  // clear() only blanks what isn't blank
+  strobes = board.counters.strobes;
+  lcd->clear();
+  lcd->print("Temp");
+  lcd->flush();
+  CHECK(board.counters.strobes - strobes == strobesPerByte(t) * ((1 + 7) + (1 + 4) + (1 + 3)));
+  CHECK_ROW(0, "Temp            ");
+  CHECK_ROW(1, "                ");
+
+  // works in right to left mode, and direct writes are tracked too
+  lcd->rightToLeft();
+  lcd->setCursor(3, 1);
+  lcd->print("abc");
+  lcd->flush();
+  CHECK_ROW(1, " cba            ");
+  lcd->noFramebuffer();
+  lcd->leftToRight();
+  lcd->setCursor(0, 0);
+  lcd->print("X");
+  lcd->framebuffer();
+  lcd->setCursor(0, 1);
+  lcd->print("full");
+  lcd->flush();
+  CHECK_ROW(0, "                ");
+  CHECK_ROW(1, "full            ");
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testAsync(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->async();
+
+  uint64_t start = board.nowNs();
+  lcd->print("Hello");
+  lcd->clear();
+  lcd->print("World");
+  CHECK(board.nowNs() - start < 1000);  // nothing waited on the LCD
+  CHECK(lcd->queueDepth() == 11);
+  CHECK_ROW(0, "                ");
+
+  // a loop() that polls between other work
+  start = board.nowNs();
+  while (lcd->queueDepth()) {
+    board.advanceNs(5000);
+    lcd->poll();
+  }
+  CHECK(board.nowNs() - start > 1520000);  // clear() kept the queue waiting
+  CHECK_ROW(0, "World           ");
+
+  // more than the queue holds still gets through
+  for (int i = 0; i < 70; i++) {
+    lcd->write('a' + i % 26);
+  }
+  lcd->flushBlocking();
+  CHECK(lcd->queueDepth() == 0);
+  CHECK_ROW(0, "Worldabcdefghijk");
+  CHECK_ROW(1, "jklmnopqrstuvwxy");
+
+  lcd->noAsync();
+  lcd->setCursor(0, 0);
+  lcd->print("sync");
+  CHECK_ROW(0, "syncdabcdefghijk");
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testAsyncBegin(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  CHECK(!lcd->ready());
+  lcd->async();
+
+  uint64_t start = board.nowNs();
+  lcd->begin(16, 2);
+  lcd->print("early");
+  CHECK(board.nowNs() - start < 1000000);  // nowhere near the 50ms power up
+  CHECK(!lcd->ready());
+
+  // other startup work runs while poll() brings the display up
+  int polls = 0;
+  while (!lcd->ready()) {
+    board.advanceNs(100000);
+    lcd->poll();
+    polls++;
+  }
+  CHECK(polls > 500);  // 50ms power up + init steps, at 100us a poll
+  CHECK(lcd->queueDepth() > 0);  // "early" is still behind it
+  CHECK(board.lcd.displayOn());
+  lcd->flushBlocking();
+  CHECK_ROW(0, "early           ");
+  CHECK(board.lcd.twoLine());
+
+  CHECK_TIMING();
+  delete lcd;
+
+  // blocking begin() reports ready straight away
+  lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  CHECK(lcd->ready());
+  delete lcd;
+}
+
+static void testSkipRedundant(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+
+  // begin() left all of these set already
+  uint32_t skipped = lcd->skippedCommands();
+  uint32_t strobes = board.counters.strobes;
+  lcd->display();
+  lcd->noCursor();
+  lcd->noBlink();
+  lcd->leftToRight();
+  lcd->noAutoscroll();
+  lcd->home();
+  lcd->setCursor(0, 0);
+  CHECK(board.counters.strobes == strobes);
+  CHECK(lcd->skippedCommands() - skipped == 7);
+
+  // the address counter is followed through writes
+  lcd->print("abc");
+  strobes = board.counters.strobes;
+  lcd->setCursor(3, 0);
+  CHECK(board.counters.strobes == strobes);
+
+  // and wraps from the end of line 0 to line 1
+  lcd->setCursor(38, 0);
+  lcd->print("xy");
+  strobes = board.counters.strobes;
+  lcd->setCursor(0, 1);
+  CHECK(board.counters.strobes == strobes);
+  lcd->print("z");
+  CHECK_ROW(1, "z               ");
+
+  // right to left counts down
+  lcd->setCursor(5, 0);
+  lcd->rightToLeft();
+  lcd->write('R');
+  strobes = board.counters.strobes;
+  lcd->setCursor(4, 0);
+  CHECK(board.counters.strobes == strobes);
+  lcd->write('L');
+  CHECK_ROW(0, "abc LR          ");
+
+  // real changes still go out
+  lcd->cursor();
+  CHECK(board.lcd.cursorOn());
+
+  // clear() sets the LCD back to left to right by itself
+  lcd->clear();
+  strobes = board.counters.strobes;
+  lcd->leftToRight();
+  CHECK(board.counters.strobes == strobes);
+  CHECK(board.lcd.entryIncrement());
+
+  // home() isn't a no-op once the display was shifted
+  lcd->print("shift");
+  lcd->scrollDisplayLeft();
+  lcd->setCursor(0, 0);
+  strobes = board.counters.strobes;
+  lcd->home();
+  CHECK(board.counters.strobes - strobes == strobesPerByte(t));
+  CHECK_ROW(0, "shift           ");
+  CHECK_TIMING();
+  delete lcd;
+
+  // 20x4: row 0 runs on into row 2
+  lcd = rigLcd(t);
+  board.lcd.setGeometry(20, 4);
+  lcd->begin(20, 4);
+  lcd->print("0123456789ABCDEFGHIJ");
+  strobes = board.counters.strobes;
+  lcd->setCursor(0, 2);
+  CHECK(board.counters.strobes == strobes);
+  lcd->print("row2");
+  CHECK_ROW(2, "row2                ");
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testTimingProfiles(Transport t)
+{
+  // HD44780 profile against the HD44780 model: clear waits 2.2ms, not 5
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  uint64_t delayUs = board.counters.delayUs;
+  lcd->clear();
+  CHECK(board.counters.delayUs - delayUs < 2210);  // + E pulses on parallel
+  delayUs = board.counters.delayUs;
+  lcd->print("ab");
+  CHECK(board.counters.delayUs - delayUs < 2 * (59 + 5));
+  CHECK_ROW(0, "ab              ");
+  CHECK_TIMING();
+  delete lcd;
+
+  // a faster controller with the matching profile
+  lcd = rigLcd(t);
+  board.lcd.setTiming(sim::WS0010_TIMING);
+  lcd->setTiming(LCD_TIMING_WINSTAR_OLED);
+  lcd->begin(16, 2);
+  delayUs = board.counters.delayUs;
+  lcd->print("OLED");
+  CHECK(board.counters.delayUs - delayUs < 4 * (10 + 5));
+  lcd->home();
+  lcd->print("o");
+  CHECK_ROW(0, "oLED            ");
+  CHECK_TIMING();
+  delete lcd;
+  if (readable(t) || t == I2C_BACKPACK) {
+    return;  // the busy flag decides, or I2C is slower than any profile
+  }
+
+  // a custom profile drives the settle times too: too short is caught
+  LCDTiming tooFast = LCD_TIMING_HD44780;
+  tooFast.data = 1;
+  lcd = rigLcd(t);
+  lcd->setTiming(tooFast);
+  lcd->begin(16, 2);
+  lcd->print("fast");
+  CHECK(board.counters.busyViolations > 0);
+  delete lcd;
+}
+
+static void testReadBack(Transport t)
+{
+  uint8_t arrow[8] = { 0x04, 0x0E, 0x1F, 0x04, 0x04, 0x04, 0x04, 0x00 };
+
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  uint64_t start = board.nowNs();
+  uint32_t pinModes = board.counters.pinModes;
+  lcd->print("Hi!");
+  if (!readable(t)) {
+    CHECK(lcd->readAddress() == 0);  // nothing to read from
+    CHECK(lcd->read() == 0);
+    delete lcd;
+    return;
+  }
+  // done as soon as the busy flag clears (41us in the model), well
+  // before the 59us profile time, and the data pins change direction
+  // through CRL/CRH rather than pinMode()
+  CHECK(board.nowNs() - start < 3 * 50000);
+  CHECK(board.counters.pinModes == pinModes);
+  CHECK(lcd->readAddress() == 3);
+  lcd->setCursor(1, 0);
+  CHECK(lcd->read() == 'i');
+  CHECK(lcd->read() == '!');
+  CHECK(lcd->readAddress() == 3);
+  lcd->setCursor(2, 1);
+  CHECK(lcd->readAddress() == 0x42);
+
+  lcd->createChar(5, arrow);
+  lcd->command(LCD_SETCGRAMADDR | (5 << 3) | 2);
+  CHECK(lcd->read() == arrow[2]);
+  CHECK(lcd->read() == arrow[3]);
+
+  start = board.nowNs();
+  lcd->clear();
+  CHECK(board.nowNs() - start < 1600000);  // 1.52ms, not the 2.2ms profile time
+  lcd->print("ok");
+  CHECK_ROW(0, "ok              ");
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static uint32_t binTotal(const uint32_t *histogram, uint8_t from = 0)
+{
+  uint32_t total = 0;
+  for (uint8_t i = from; i < LCD_STATS_BINS; i++) {
+    total += histogram[i];
+  }
+  return total;
+}
+
+static void testStats(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->begin(16, 2);
+  lcd->resetStats();
+  const LCDStats &stats = lcd->getStats();
+  CHECK(stats.sends == 0 && stats.data == 0 && stats.transfers == 0);
+
+  lcd->print("abc");        // a send() per character
+  lcd->setCursor(0, 1);
+  lcd->setCursor(0, 1);     // skipped, but still a send()
+  lcd->write('d');
+  CHECK(stats.sends == 6);
+  CHECK(stats.commands == 1);
+  CHECK(stats.data == 4);
+  CHECK(binTotal(stats.dataCycles) == 4);
+  CHECK(binTotal(stats.commandCycles) == 1);
+  CHECK(binTotal(stats.transferCycles) == stats.transfers);
+  if (t < PARALLEL_4BIT) {
+    CHECK(stats.transfers >= 5);
+  }
+  else {
+    CHECK(stats.transfers == 0);
+  }
+  if (!readable(t) && t != I2C_BACKPACK) {
+    CHECK(stats.waitUs >= 4 * 59 + 53 && stats.waitUs <= 4 * 59 + 53 + 5);
+    // a character settles for 59us: 4248 cycles, bin 5 (< 8192)
+    CHECK(binTotal(stats.dataCycles, 5) == 4);
+  }
+
+  // clear() takes 2ms, > 128k cycles
+  lcd->clear();
+  CHECK(binTotal(stats.commandCycles, 9) == 1);
+
+  // async: counted when poll() puts them on the bus
+  lcd->resetStats();
+  lcd->async();
+  lcd->print("xy");
+  CHECK(stats.sends == 2 && stats.data == 0);
+  lcd->flushBlocking();
+  CHECK(stats.data == 2);
+  CHECK(stats.waitUs == 0);
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static const char *const COMMAND_NAMES[8] = {
+  "clear", "home", "entry mode", "display control",
+  "shift", "function set", "cgram address", "ddram address"
+};
+
+// Decoded trace as text: one line per instruction, runs of data bytes
+// on one line
+static std::string describe(LiquidCrystalTrace &trace)
+{
+  CHECK(!trace.overflowed());
+  uint16_t bytes[512];
+  uint16_t n = trace.decode(bytes, 512);
+  CHECK(n > 0);
+  std::string s;
+  char buf[32];
+  for (uint16_t i = 0; i < n; i++) {
+    if (bytes[i] & LCD_TRACE_RS) {
+      s += "data \"";
+      for (; i < n && (bytes[i] & LCD_TRACE_RS); i++) {
+        uint8_t c = bytes[i] & 0xFF;
+        if (c >= 0x20 && c < 0x7F && c != '"' && c != '\\') {
+          s += (char)c;
+        }
+        else {
+          snprintf(buf, sizeof(buf), "\\x%02x", c);
+          s += buf;
+        }
+      }
+      i--;
+      s += "\"\n";
+      continue;
+    }
+    uint8_t value = bytes[i];
+    int bit = 7;
+    while (bit > 0 && !(value & (1 << bit))) {
+      bit--;
+    }
+    snprintf(buf, sizeof(buf), "cmd %02x %s\n", value, value ? COMMAND_NAMES[bit] : "nop");
+    s += buf;
+  }
+  return s;
+}
+
+// What the controller receives, decoded from a bus trace, has to match
+// the golden files byte for byte on every transport
+static void testGoldenTraces(Transport t)
+{
+  uint8_t smiley[8] = { 0x00, 0x0A, 0x0A, 0x00, 0x11, 0x0E, 0x00, 0x00 };
+  static LCDTraceFrame frames[4096];
+  LiquidCrystalTrace trace(frames, 4096);
+
+  LiquidCrystal *lcd = rigLcd(t);
+  lcd->trace(&trace);
+  lcd->begin(16, 2);
+  CHECK_GOLDEN(eightBit(t) ? "begin-8bit" : "begin-4bit", describe(trace));
+
+  lcd->print("Hello, World!");
+  lcd->setCursor(0, 1);
+  lcd->print(1234);
+  lcd->write('!');
+  CHECK_GOLDEN("print", describe(trace));
+
+  lcd->createChar(0, smiley);
+  lcd->createChar(7, smiley);
+  lcd->setCursor(15, 1);
+  lcd->write(7);
+  CHECK_GOLDEN("create-char", describe(trace));
+
+  lcd->scrollDisplayLeft();
+  lcd->scrollDisplayLeft();
+  lcd->scrollDisplayRight();
+  lcd->autoscroll();
+  lcd->print("ab");
+  lcd->noAutoscroll();
+  lcd->home();
+  CHECK_GOLDEN("scroll", describe(trace));
+  CHECK_TIMING();
+  delete lcd;
+}
+
+static void testSoftSpiPorts(Transport t)
+{
+  (void)t;
+  // clock on port A, data and latch on port B: the three-store path
+  board.reset();
+  board.wire595(D2, D5, D4, BACKPACK_595);
+  LiquidCrystal *lcd = new LiquidCrystal(D2, D5, D4);
+  lcd->initSPI();
+  lcd->begin(16, 2);
+  lcd->print("split ports");
+  CHECK_ROW(0, "split ports     ");
+  CHECK(board.pinRead(D5) == LOW);  // clock left low
+  CHECK_TIMING();
+  delete lcd;
+
+  // all on port B (the default rig): clock and data share BSRR stores
+  lcd = rigLcd(SOFTWARE_SPI);
+  lcd->begin(16, 2);
+  lcd->write('>');  // RS goes high
+  uint32_t bits = board.counters.bitsShifted;
+  lcd->print("shared");
+  CHECK(board.counters.bitsShifted - bits == 6 * 4 * 8);
+  CHECK_ROW(0, ">shared         ");
+  CHECK(board.pinRead(D3) == LOW);
+  CHECK_TIMING();
+  delete lcd;
+}
+
+// begin() and two lines on n displays sharing one bus, returns the
+// time the two lines took
+static uint64_t busRefresh(Transport t, uint8_t n)
+{
+  static const uint8_t latches[] = { A1, A0 };
+  LiquidCrystal *lcds[3];
+  uint8_t display[3] = { 0 };
+  LiquidCrystalBus bus;
+
+  lcds[0] = rigLcd(t);
+  for (uint8_t i = 1; i < n; i++) {
+    lcds[i] = rigAnotherLcd(t, latches[i - 1], &display[i]);
+  }
+  for (uint8_t i = 0; i < n; i++) {
+    CHECK(bus.attach(*lcds[i]));
+    lcds[i]->begin(16, 2);
+  }
+  bus.flushBlocking();
+
+  uint64_t start = board.nowNs();
+  for (uint8_t i = 0; i < n; i++) {
+    lcds[i]->print("display ");
+    lcds[i]->print(i);
+    lcds[i]->setCursor(0, 1);
+    lcds[i]->print("0123456789ABCDEF");
+  }
+  bus.flushBlocking();
+  uint64_t ns = board.nowNs() - start;
+
+  for (uint8_t i = 0; i < n; i++) {
+    std::string row0 = board.display(display[i]).row(0);
+    CHECK(row0 == std::string("display ") + (char)('0' + i) + "       ");
+    CHECK(board.display(display[i]).row(1) == "0123456789ABCDEF");
+    CHECK(lcds[i]->ready());
+  }
+  CHECK_TIMING();
+
+  // SPI settings are loaded once, not on every switch between displays
+  if (t != SOFTWARE_SPI) {
+    CHECK(bus.settingChanges() == 1);
+    bus.release();
+    lcds[0]->print("!");
+    bus.flushBlocking();
+    CHECK(bus.settingChanges() == 2);
+  }
+  else {
+    CHECK(bus.settingChanges() == 0);
+  }
+  for (uint8_t i = 0; i < n; i++) {
+    delete lcds[i];
+  }
+  return ns;
+}
+
+static void testSharedBus(Transport t)
+{
+  if (t == I2C_BACKPACK) {
+    return; // the board has one expander
+  }
+  uint64_t one = busRefresh(t, 1);
+  uint64_t three = busRefresh(t, 3);
+  CHECK(three < one * 3 / 2);  // overlapped, not 3x
+
+  // a display with its own clock divider has it loaded when selected
+  if (t != SOFTWARE_SPI) {
+    LiquidCrystalBus bus;
+    LiquidCrystal *near = rigLcd(t);
+    LiquidCrystal *far = rigAnotherLcd(t, A1);
+    far->setClockDivider(SPI_CLOCK_DIV32);
+    bus.attach(*near);
+    bus.attach(*far);
+    near->begin(16, 2);
+    bus.flushBlocking();
+    CHECK(SPI.clockDivider == SPI_CLOCK_DIV8);
+    far->begin(16, 2);
+    bus.flushBlocking();
+    CHECK(SPI.clockDivider == SPI_CLOCK_DIV32);
+    CHECK(bus.settingChanges() == 2);
+    delete near;
+    delete far;
+  }
+}
+
+static void testI2cBursts(Transport t)
+{
+  LiquidCrystal *lcd = rigLcd(t);
+  CHECK(board.expander.reg(sim::MCP23008::IOCON) & sim::MCP23008::SEQOP);
+  CHECK(board.expander.reg(sim::MCP23008::IODIR) == 0x00);
+  lcd->begin(16, 2);
+  lcd->write('a');  // RS goes high
+
+  // one transaction per character: register + both nibbles with E
+  uint32_t transactions = board.counters.i2cTransactions;
+  uint32_t bits = board.counters.bitsShifted;
+  lcd->print("bcd");
+  CHECK(board.counters.i2cTransactions - transactions == 3);
+  CHECK(board.counters.bitsShifted - bits == 3 * (1 + 1 + 4) * 8);
+  CHECK_ROW(0, "abcd            ");
+
+  // at 400kHz the next write's lead-in still covers the settle time
+  Wire.setSpeed(CLOCK_SPEED_400KHZ);
+  lcd->setCursor(0, 1);
+  lcd->print("fast mode");
+  lcd->clear();
+  lcd->print("cleared");
+  CHECK_ROW(0, "cleared         ");
+  CHECK_TIMING();
+  Wire.setSpeed(CLOCK_SPEED_100KHZ);
+
+  lcd->backlight();
+  CHECK(board.lcd.backlight());
+  delete lcd;
+
+  // the A0-A2 jumpers move the address
+  board.reset();
+  board.wireMcp23008(0x23, BACKPACK_MCP23008);
+  lcd = new LiquidCrystal(3);
+  lcd->initI2C();
+  lcd->begin(16, 2);
+  lcd->print("addr 3");
+  CHECK_ROW(0, "addr 3          ");
+  delete lcd;
+}
+
+template <class Lcd>
+static void checkTemplate(Transport t)
+{
+  uint8_t heart[8] = { 0x00, 0x0A, 0x1F, 0x1F, 0x0E, 0x04, 0x00, 0x00 };
+
+  rigBoard(t);
+  Lcd lcd;
+  lcd.begin(16, 2);
+  CHECK(!board.lcd.eightBit());
+  CHECK(board.lcd.twoLine());
+  CHECK(board.lcd.displayOn());
+
+  lcd.print("Hello, Sparky!");
+  lcd.setCursor(0, 1);
+  lcd.print(1234);
+  CHECK_ROW(0, "Hello, Sparky!  ");
+  CHECK_ROW(1, "1234            ");
+
+  // same transfers per character as LiquidCrystal
+  uint32_t latches = board.counters.latches;
+  lcd.print("56");
+  CHECK(board.counters.latches - latches == 2 * 4);
+
+  // rows past the last clamp the same way as LiquidCrystal::setCursor()
+  lcd.setCursor(6, 2);
+  lcd.print("!");
+  CHECK_ROW(1, "123456!         ");
+
+  lcd.createChar(3, heart);
+  for (int i = 0; i < 8; i++) {
+    CHECK(board.lcd.cgram(3 * 8 + i) == heart[i]);
+  }
+  lcd.clear();
+  lcd.cursor();
+  lcd.write(3);
+  CHECK(board.lcd.ddram(0x00) == 3);
+  CHECK(board.lcd.cursorOn());
+  lcd.scrollDisplayLeft();
+  CHECK_ROW(0, "                ");
+
+  lcd.backlight();
+  CHECK(board.lcd.backlight());
+  lcd.noBacklight();
+  CHECK(!board.lcd.backlight());
+
+  // the front end is LiquidCrystal's: redundant commands are skipped
+  // and framebuffer mode works
+  uint32_t skipped = lcd.skippedCommands();
+  lcd.setCursor(0, 1);
+  lcd.setCursor(0, 1);
+  CHECK(lcd.skippedCommands() == skipped + 1);
+  lcd.clear();
+  lcd.framebuffer();
+  lcd.setCursor(0, 1);
+  lcd.print("fb");
+  CHECK_ROW(1, "                ");
+  lcd.flush();
+  CHECK_ROW(1, "fb              ");
+  CHECK_TIMING();
+}
+
+static void testTemplate(Transport t)
+{
+  if (t == CASCADE_SPI || t == I2C_BACKPACK) {
+    return; // LiquidCrystalT only has the single 595 transports
+  }
+  if (t == HARDWARE_SPI) {
+    checkTemplate<HardwareSpiLcdT>(t);
+  }
+  else {
+    checkTemplate<SoftwareSpiLcdT>(t);
+  }
+}
+
+/* ========= Main ======================== */
+
+typedef void (*TestFn)(Transport);
+
+enum {
+  ALL = 0,
+  SPI_ONLY,      // the backpack transports, I2C included
+  SOFT_SPI_ONLY,
+  I2C_ONLY
+};
+
+struct TestCase {
+  const char *name;
+  TestFn fn;
+  uint8_t only;
+};
+
+static const TestCase TESTS[] = {
+  { "begin-and-print",  testBeginAndPrint,  ALL },
+  { "clear-home",       testClearHome,      ALL },
+  { "create-char",      testCreateChar,     ALL },
+  { "glyph-cache",      testGlyphCache,     ALL },
+  { "widgets",          testWidgets,        ALL },
+  { "marquee",          testMarquee,        ALL },
+  { "number-fields",    testNumberFields,   ALL },
+  { "scheduler",        testScheduler,      ALL },
+  { "display-controls", testDisplayControls, ALL },
+  { "scroll",           testScroll,         ALL },
+  { "backlight",        testBacklight,      SPI_ONLY },
+  { "four-rows",        testFourRows,       ALL },
+  { "nibble-transfers", testNibbleTransfers, SPI_ONLY },
+  { "framebuffer",      testFramebuffer,    ALL },
+  { "async",            testAsync,          ALL },
+  { "skip-redundant",   testSkipRedundant,  ALL },
+  { "async-begin",      testAsyncBegin,     ALL },
+  { "timing-profiles",  testTimingProfiles, ALL },
+  { "read-back",        testReadBack,       ALL },
+  { "stats",            testStats,          ALL },
+  { "golden-traces",    testGoldenTraces,   ALL },
+  { "soft-spi-ports",   testSoftSpiPorts,   SOFT_SPI_ONLY },
+  { "template",         testTemplate,       SPI_ONLY },
+  { "shared-bus",       testSharedBus,      SPI_ONLY },
+  { "i2c-bursts",       testI2cBursts,      I2C_ONLY },
+};
+
+int main()
+{
+  for (size_t i = 0; i < sizeof(TESTS) / sizeof(TESTS[0]); i++) {
+    for (int t = 0; t < TRANSPORT_COUNT; t++) {
+      if ((TESTS[i].only == SPI_ONLY && t >= PARALLEL_4BIT) ||
+          (TESTS[i].only == SOFT_SPI_ONLY && t != SOFTWARE_SPI) ||
+          (TESTS[i].only == I2C_ONLY && t != I2C_BACKPACK)) {
+        continue;
+      }
+      int before = failures;
+      TESTS[i].fn((Transport)t);
+      printf("%-4s %s/%s\n", failures == before ? "ok" : "FAIL",
+             TESTS[i].name, TRANSPORT_NAMES[t]);
+    }
+  }
+  printf("%d checks, %d failures\n", checks, failures);
+  return failures ? 1 : 0;
+}